@@ -91,6 +91,25 @@ boolean osal_timer_is_expired (osal_timert *self)
    	return is_not_yet_expired == FALSE;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+	return (int64)osEE_x86_64_tsc_read();
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+	int64 left;
+
+	left = abstime - osal_monotonic_ns();
+	if (left > 0)
+	{
+		osal_usleep((uint32)(left / 1000));
+	}
+	return 0;
+}
+
 void *osal_malloc(size_t size)
 {
    	return malloc(size);
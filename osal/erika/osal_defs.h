@@ -30,6 +30,10 @@ extern "C"
 #define PACKED_END
 #endif
 
+#define OSAL_THREAD_HANDLE void *
+#define OSAL_THREAD_FUNC void
+#define OSAL_THREAD_FUNC_RT void
+
 int osal_gettimeofday(struct timeval *tv, struct timezone *tz);
 void *osal_malloc(size_t size);
 void osal_free(void *ptr);
@@ -57,6 +57,28 @@ boolean osal_timer_is_expired (osal_timert * self)
    return is_not_yet_expired == FALSE;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+   struct timeval tv;
+
+   osal_gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000 + (int64)tv.tv_usec * 1000;
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+   int64 left;
+
+   left = abstime - osal_monotonic_ns();
+   if (left > 0)
+   {
+      osal_usleep((uint32)(left / 1000));
+   }
+   return 0;
+}
+
 int osal_usleep(uint32 usec)
 {
    RtSleepEx (usec / 1000);
@@ -89,6 +89,31 @@ boolean osal_timer_is_expired (osal_timert * self)
    return is_not_yet_expired == FALSE;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once.
+ * There is no clock_nanosleep(), the remaining time is slept relative. */
+int osal_sleep_until_ns(int64 abstime)
+{
+   struct timespec ts;
+   int64 left;
+
+   while ((left = abstime - osal_monotonic_ns()) > 0)
+   {
+      ts.tv_sec = left / 1000000000;
+      ts.tv_nsec = left % 1000000000;
+      nanosleep(&ts, NULL);
+   }
+   return 0;
+}
+
 void *osal_malloc(size_t size)
 {
    return malloc(size);
@@ -142,3 +167,10 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 
    return 1;
 }
+
+/* Wait for a thread of osal_thread_create() or osal_thread_create_rt() to
+ * end and release it */
+int osal_thread_join(void *thandle)
+{
+   return (pthread_join(*(pthread_t *)thandle, NULL) == 0);
+}
@@ -49,8 +49,11 @@ boolean osal_timer_is_expired(osal_timert * self);
 int osal_usleep(uint32 usec);
 ec_timet osal_current_time(void);
 void osal_time_diff(ec_timet *start, ec_timet *end, ec_timet *diff);
+int64 osal_monotonic_ns(void);
+int osal_sleep_until_ns(int64 abstime);
 int osal_thread_create(void *thandle, int stacksize, void *func, void *param);
 int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param);
+int osal_thread_join(void *thandle);
 
 #ifdef __cplusplus
 }
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <osal.h>
 
 #define USECS_PER_SEC     1000000
@@ -89,6 +90,28 @@ boolean osal_timer_is_expired (osal_timert * self)
    return is_not_yet_expired == FALSE;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+   struct timespec ts;
+   int ret;
+
+   ts.tv_sec = abstime / 1000000000;
+   ts.tv_nsec = abstime % 1000000000;
+   /* absolute wakeup does not drift when the sleep is interrupted */
+   while ((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+   return ret;
+}
+
 void *osal_malloc(size_t size)
 {
    return malloc(size);
@@ -142,3 +165,10 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 
    return 1;
 }
+
+/* Wait for a thread of osal_thread_create() or osal_thread_create_rt() to
+ * end and release it */
+int osal_thread_join(void *thandle)
+{
+   return (pthread_join(*(pthread_t *)thandle, NULL) == 0);
+}
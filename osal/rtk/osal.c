@@ -114,6 +114,28 @@ boolean osal_timer_is_expired (osal_timert * self)
    return is_not_yet_expired == false;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000 + (int64)tv.tv_usec * 1000;
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+   int64 left;
+
+   left = abstime - osal_monotonic_ns();
+   if (left > 0)
+   {
+      osal_usleep((uint32)(left / 1000));
+   }
+   return 0;
+}
+
 void *osal_malloc(size_t size)
 {
    return malloc(size);
@@ -143,3 +165,10 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    }
    return 1;
 }
+
+/* Tasks can not be joined, the kernel releases a task when it returns */
+int osal_thread_join(void *thandle)
+{
+   (void)thandle;
+   return 1;
+}
@@ -121,6 +121,28 @@ int osal_usleep(uint32 usec)
    return 1;
 }
 
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+   struct timeval tv;
+
+   osal_getrelativetime (&tv, 0);
+   return (int64)tv.tv_sec * 1000000000 + (int64)tv.tv_usec * 1000;
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+   int64 left;
+
+   left = abstime - osal_monotonic_ns();
+   if (left > 0)
+   {
+      osal_usleep ((uint32)(left / 1000));
+   }
+   return 0;
+}
+
 void *osal_malloc(size_t size)
 {
    return malloc(size);
@@ -151,3 +173,17 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    }
    return ret;
 }
+
+/* Wait for a thread of osal_thread_create() or osal_thread_create_rt() to
+ * end and release it */
+int osal_thread_join(void *thandle)
+{
+   HANDLE thread = *(OSAL_THREAD_HANDLE *)thandle;
+
+   if (WaitForSingleObject(thread, INFINITE) != WAIT_OBJECT_0)
+   {
+      return 0;
+   }
+   CloseHandle(thread);
+   return 1;
+}
@@ -94,3 +94,98 @@ boolean osal_timer_is_expired(osal_timert *self)
 
 	return is_not_yet_expired == FALSE;
 }
+
+/* Monotonic time in ns, time base of osal_sleep_until_ns() */
+int64 osal_monotonic_ns(void)
+{
+	return (int64)k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+/* Sleep until absolute monotonic time in ns, a time in the past returns at once */
+int osal_sleep_until_ns(int64 abstime)
+{
+	k_sleep(K_TIMEOUT_ABS_TICKS(k_ns_to_ticks_ceil64(abstime)));
+
+	return 0;
+}
+
+static void osal_thread_entry(void *func, void *param, void *unused)
+{
+	void (*entry)(void *) = func;
+
+	ARG_UNUSED(unused);
+	entry(param);
+}
+
+#ifdef CONFIG_DYNAMIC_THREAD
+/* Thread of osal_thread_create(), the handle points to its k_thread */
+struct osal_thread {
+	struct k_thread thread;
+	k_thread_stack_t *stack;
+};
+#endif
+
+/* Threads need CONFIG_DYNAMIC_THREAD and a kernel heap for their memory,
+ * which is freed by osal_thread_join(). */
+static int osal_thread_spawn(void *thandle, int stacksize, void *func, void *param, int prio)
+{
+#ifdef CONFIG_DYNAMIC_THREAD
+	struct osal_thread *t;
+
+	t = k_malloc(sizeof(*t));
+	if (t == NULL) {
+		return 0;
+	}
+	t->stack = k_thread_stack_alloc(stacksize, 0);
+	if (t->stack == NULL) {
+		k_free(t);
+		return 0;
+	}
+	*(struct k_thread **)thandle = &t->thread;
+	k_thread_create(&t->thread, t->stack, stacksize, osal_thread_entry, func, param, NULL,
+			prio, 0, K_NO_WAIT);
+
+	return 1;
+#else
+	ARG_UNUSED(thandle);
+	ARG_UNUSED(stacksize);
+	ARG_UNUSED(func);
+	ARG_UNUSED(param);
+	ARG_UNUSED(prio);
+
+	return 0;
+#endif
+}
+
+int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
+{
+	return osal_thread_spawn(thandle, stacksize, func, param, K_LOWEST_APPLICATION_THREAD_PRIO);
+}
+
+int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
+{
+	return osal_thread_spawn(thandle, stacksize, func, param, K_HIGHEST_APPLICATION_THREAD_PRIO);
+}
+
+/* Wait for a thread of osal_thread_create() or osal_thread_create_rt() to
+ * end and free its memory */
+int osal_thread_join(void *thandle)
+{
+#ifdef CONFIG_DYNAMIC_THREAD
+	struct osal_thread *t;
+
+	t = CONTAINER_OF(*(struct k_thread **)thandle, struct osal_thread, thread);
+	if (k_thread_join(&t->thread, K_FOREVER) != 0) {
+		return 0;
+	}
+	k_thread_stack_free(t->stack);
+	k_free(t);
+	*(struct k_thread **)thandle = NULL;
+
+	return 1;
+#else
+	ARG_UNUSED(thandle);
+
+	return 0;
+#endif
+}
@@ -16,4 +16,8 @@
 #define PACKED_END
 #endif
 
+#define OSAL_THREAD_HANDLE struct k_thread *
+#define OSAL_THREAD_FUNC void
+#define OSAL_THREAD_FUNC_RT void
+
 #endif
@@ -263,6 +263,44 @@ int ecx_outframe_red(ecx_portt *port, uint8 idx)
    	return rval;
 }
 
+/** Queue buffer for transmission with ecx_flushframes(). This port has no
+ * batched transmission, so the frame is sent right away.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @return socket send result
+ */
+int ecx_queueframe_red(ecx_portt *port, uint8 idx)
+{
+   return ecx_outframe_red(port, idx);
+}
+
+/** Transmit all frames queued with ecx_queueframe_red().
+ * @param[in] port        = port context struct
+ * @return number of frames sent, always 0 as frames are not queued
+ */
+int ecx_flushframes(ecx_portt *port)
+{
+   (void)port;
+   return 0;
+}
+
+/** Have the data of a received datagram copied straight to its place. This
+ * port has no such receive path, the caller copies it from the rx buffer.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[in] data        = where the datagram data goes
+ * @param[in] length      = length of datagram data
+ * @return FALSE, the data is never placed
+ */
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length)
+{
+   (void)port;
+   (void)idx;
+   (void)data;
+   (void)length;
+   return FALSE;
+}
+
 /** Non blocking read of socket. Put frame in temporary buffer.
  * @param[in] port        = port context struct
  * @param[in] stacknumber = 0=primary 1=secondary stack
@@ -544,6 +582,16 @@ int ec_outframe_red(uint8 idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_queueframe_red(uint8 idx)
+{
+   return ecx_queueframe_red(&ecx_port, idx);
+}
+
+int ec_flushframes(void)
+{
+   return ecx_flushframes(&ecx_port);
+}
+
 int ec_inframe(uint8 idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -98,6 +98,8 @@ void ec_setbufstat(uint8 idx, int bufstat);
 uint8 ec_getindex(void);
 int ec_outframe(uint8 idx, int sock);
 int ec_outframe_red(uint8 idx);
+int ec_queueframe_red(uint8 idx);
+int ec_flushframes(void);
 int ec_waitinframe(uint8 idx, int timeout);
 int ec_srconfirm(uint8 idx,int timeout);
 int ec_inframe(uint8 idx, int stacknumber);
@@ -110,6 +112,9 @@ void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
 uint8 ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_queueframe_red(ecx_portt *port, uint8 idx);
+int ecx_flushframes(ecx_portt *port);
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
 
@@ -28,8 +28,24 @@
  * packets. The software layer will detect the possible failure modes and
  * compensate. If needed the packets from interface A are resent through interface B.
  * This layer if fully transparent for the higher layers.
+ *
+ * With the ECT_PORT_MMAP backend the sockets use PACKET_MMAP rx and tx rings.
+ * Received frames are taken from memory shared with the kernel, so polling for
+ * a frame that has not yet arrived costs no syscall. TPACKET_V2 is used rather
+ * than TPACKET_V3 because V3 only hands over a block of frames when it is full
+ * or its retire timer (millisecond resolution) expires, which is far too late
+ * for EtherCAT round trips.
+ *
+ * The ECT_PORT_XDP backend moves frames through an AF_XDP socket instead, see
+ * nicdrv_xdp.c. The raw socket is still opened to configure the interface.
+ *
+ * All frames sent and received can be captured to a pcapng file with
+ * ecx_capture_start(), see nicdrv_pcap.c.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -39,13 +55,25 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
-#include <netpacket/packet.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <linux/if_packet.h>
+#include <linux/sockios.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <pthread.h>
 
 #include "oshw.h"
 #include "osal.h"
+#include "nicdrv_xdp.h"
+#include "nicdrv_pcap.h"
 
 /** Redundancy modes */
 enum
@@ -72,20 +100,306 @@ const uint16 secMAC[3] = { 0x0404, 0x0404, 0x0404 };
 /** second MAC word is used for identification */
 #define RX_SEC secMAC[1]
 
-static void ecx_clear_rxbufstat(int *rxbufstat)
+/** size of one frame slot in the packet rings */
+#define EC_RINGFRAMESIZE 2048
+/** number of frame slots in each packet ring */
+#define EC_RINGFRAMES    64
+/** longest sleep in ppoll() in us, a frame read by another thread does not
+ * wake the waiting thread so it has to look again from time to time */
+#define EC_POLLSLICE     50
+/** size of control message buffer for one received frame */
+#define EC_CMSGSIZE      CMSG_SPACE(sizeof(struct scm_timestamping))
+/** alignment of the arrays in a buffer pool, one cache line */
+#define EC_POOLALIGN     64
+
+static void ecx_clear_rxbufstat(int *rxbufstat, int n)
 {
    int i;
-   for(i = 0; i < EC_MAXBUF; i++)
+   for(i = 0; i < n; i++)
    {
       rxbufstat[i] = EC_BUF_EMPTY;
    }
 }
 
+/** Take next array from a buffer pool. With pool NULL only the used size is
+ * counted, so the same sequence of calls first sizes and then carves the pool.
+ * @param[in] pool        = buffer pool or NULL
+ * @param[in,out] used    = bytes of pool used
+ * @param[in] size        = size of array in bytes
+ * @return array, NULL if pool is NULL
+ */
+static void *ecx_poolarray(uint8 *pool, size_t *used, size_t size)
+{
+   void *p;
+
+   p = pool ? pool + *used : NULL;
+   *used += (size + EC_POOLALIGN - 1) & ~(size_t)(EC_POOLALIGN - 1);
+
+   return p;
+}
+
+/** Carve the per index arrays of the primary port from its pool.
+ * @param[in] port        = port context struct
+ * @param[in] pool        = buffer pool, NULL to get the size only
+ * @return size of pool in bytes
+ */
+static size_t ecx_portpool(ecx_portt *port, uint8 *pool)
+{
+   size_t used = 0;
+   int n = port->maxbuf;
+
+   port->txbuf       = ecx_poolarray(pool, &used, n * sizeof(ec_bufT));
+   port->rxmem       = ecx_poolarray(pool, &used, (n + EC_MAXBUF) * sizeof(ec_bufT));
+   port->rxbuf       = ecx_poolarray(pool, &used, n * sizeof(uint8 *));
+   port->rxbufstat   = ecx_poolarray(pool, &used, n * sizeof(int));
+   port->rxsa        = ecx_poolarray(pool, &used, n * sizeof(int));
+   port->txbuflength = ecx_poolarray(pool, &used, n * sizeof(int));
+   port->txtime      = ecx_poolarray(pool, &used, n * sizeof(int64));
+   port->rxtime      = ecx_poolarray(pool, &used, n * sizeof(int64));
+   port->rxplace     = ecx_poolarray(pool, &used, n * sizeof(uint8 *));
+   port->rxplacelen  = ecx_poolarray(pool, &used, n * sizeof(int));
+   port->txqueue     = ecx_poolarray(pool, &used, n * sizeof(uint8));
+
+   return used;
+}
+
+/** Carve the per index arrays of the redundant port from its pool.
+ * @param[in] redport     = redundant port struct
+ * @param[in] n           = number of frame indexes
+ * @param[in] pool        = buffer pool, NULL to get the size only
+ * @return size of pool in bytes
+ */
+static size_t ecx_redportpool(ecx_redportt *redport, int n, uint8 *pool)
+{
+   size_t used = 0;
+
+   redport->rxmem     = ecx_poolarray(pool, &used, n * sizeof(ec_bufT));
+   redport->rxbuf     = ecx_poolarray(pool, &used, n * sizeof(uint8 *));
+   redport->rxbufstat = ecx_poolarray(pool, &used, n * sizeof(int));
+   redport->rxsa      = ecx_poolarray(pool, &used, n * sizeof(int));
+   redport->txtime    = ecx_poolarray(pool, &used, n * sizeof(int64));
+   redport->rxtime    = ecx_poolarray(pool, &used, n * sizeof(int64));
+
+   return used;
+}
+
+/** Allocate a zeroed buffer pool, aligned to a cache line.
+ * @param[in] size        = size of pool in bytes
+ * @return pool, NULL if out of memory
+ */
+static void *ecx_poolalloc(size_t size)
+{
+   void *pool;
+
+   if (posix_memalign(&pool, EC_POOLALIGN, size) != 0)
+   {
+      return NULL;
+   }
+   memset(pool, 0, size);
+
+   return pool;
+}
+
+/** Setup mmap'd rx and tx packet rings on socket.
+ * @param[in] sock        = socket handle
+ * @param[out] ring       = ring state
+ * @param[in] frames      = minimum number of frame slots per ring
+ * @return >0 if succeeded, on failure the socket is left in plain mode
+ */
+static int ecx_setupring(int sock, ec_ringt *ring, int frames)
+{
+   struct tpacket_req req;
+   int version, blocksize, framesperblock;
+
+   ring->map = NULL;
+   version = TPACKET_V2;
+   if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+      return 0;
+   blocksize = (int)sysconf(_SC_PAGESIZE);
+   if (blocksize < EC_RINGFRAMESIZE)
+      blocksize = EC_RINGFRAMESIZE;
+   framesperblock = blocksize / EC_RINGFRAMESIZE;
+   req.tp_block_size = blocksize;
+   if (frames < EC_RINGFRAMES)
+      frames = EC_RINGFRAMES;
+   req.tp_block_nr = (frames + framesperblock - 1) / framesperblock;
+   req.tp_frame_size = EC_RINGFRAMESIZE;
+   req.tp_frame_nr = req.tp_block_nr * framesperblock;
+   if ((setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == 0) &&
+       (setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == 0))
+   {
+      ring->maplen = 2 * (size_t)req.tp_block_size * req.tp_block_nr;
+      ring->map = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+      if (ring->map == MAP_FAILED)
+      {
+         /* locked memory may be limited, retry without */
+         ring->map = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+      }
+   }
+   if ((ring->map == NULL) || (ring->map == MAP_FAILED))
+   {
+      /* release any ring already set up, else recv() and send() stop working */
+      ring->map = NULL;
+      memset(&req, 0, sizeof(req));
+      setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+      setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+      return 0;
+   }
+   ring->rx = ring->map;
+   ring->tx = ring->map + ring->maplen / 2;
+   ring->framesize = req.tp_frame_size;
+   ring->framenr = req.tp_frame_nr;
+   ring->rxhead = 0;
+   ring->txhead = 0;
+
+   return 1;
+}
+
+/** Unmap packet rings.
+ * @param[in] ring        = ring state
+ */
+static void ecx_closering(ec_ringt *ring)
+{
+   if (ring->map)
+   {
+      munmap(ring->map, ring->maplen);
+      ring->map = NULL;
+   }
+}
+
+/** Enable SO_TIMESTAMPING on socket. Hardware timestamps are used if the NIC
+ * accepts to timestamp all frames, otherwise the kernel timestamps in software.
+ * Transmit timestamps are returned through the socket error queue together
+ * with the sent frame, so they can be matched to the frame index.
+ * @param[in] sock        = socket handle
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] ring        = ring state, rx timestamps are taken from the ring
+ * @param[out] hwts       = NIC config found, for ecx_restoretstamp()
+ * @return ECT_TSTAMP_HARDWARE, ECT_TSTAMP_SOFTWARE or ECT_TSTAMP_NONE
+ */
+static int ecx_setuptstamp(int sock, const char *ifname, ec_ringt *ring, ec_hwtstampt *hwts)
+{
+   struct ifreq ifr;
+   struct hwtstamp_config hwconfig;
+   int flags, mode, r;
+
+   /* the config is NIC wide, keep the one found to put it back on close */
+   memset(hwts, 0, sizeof(*hwts));
+   strncpy(hwts->ifname, ifname, IFNAMSIZ - 1);
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+   ifr.ifr_data = (void *)&(hwts->config);
+   r = ioctl(sock, SIOCGHWTSTAMP, &ifr);
+   memset(&hwconfig, 0, sizeof(hwconfig));
+   hwconfig.tx_type = HWTSTAMP_TX_ON;
+   hwconfig.rx_filter = HWTSTAMP_FILTER_ALL;
+   ifr.ifr_data = (void *)&hwconfig;
+   /* without SIOCGHWTSTAMP the config could not be put back, leave it */
+   if ((r == 0) && (ioctl(sock, SIOCSHWTSTAMP, &ifr) == 0))
+   {
+      hwts->saved = TRUE;
+   }
+   /* the driver may narrow the rx filter, EtherCAT frames are no PTP frames */
+   if (hwts->saved && (hwconfig.rx_filter == HWTSTAMP_FILTER_ALL))
+   {
+      flags = SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+              SOF_TIMESTAMPING_RAW_HARDWARE;
+      mode = ECT_TSTAMP_HARDWARE;
+   }
+   else
+   {
+      flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+              SOF_TIMESTAMPING_SOFTWARE;
+      mode = ECT_TSTAMP_SOFTWARE;
+   }
+   if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+   {
+      return ECT_TSTAMP_NONE;
+   }
+   /* rx ring slots carry a software timestamp unless told otherwise */
+   if (ring->map && (mode == ECT_TSTAMP_HARDWARE))
+   {
+      flags = SOF_TIMESTAMPING_RAW_HARDWARE;
+      setsockopt(sock, SOL_PACKET, PACKET_TIMESTAMP, &flags, sizeof(flags));
+   }
+
+   return mode;
+}
+
+/** Put back the NIC timestamping config ecx_setuptstamp() found.
+ * @param[in] sock        = socket handle, still open
+ * @param[in] hwts        = config kept by ecx_setuptstamp()
+ */
+static void ecx_restoretstamp(int sock, ec_hwtstampt *hwts)
+{
+   struct ifreq ifr;
+
+   if (hwts->saved && (sock >= 0))
+   {
+      memset(&ifr, 0, sizeof(ifr));
+      strncpy(ifr.ifr_name, hwts->ifname, IFNAMSIZ - 1);
+      ifr.ifr_data = (void *)&(hwts->config);
+      ioctl(sock, SIOCSHWTSTAMP, &ifr);
+   }
+   hwts->saved = FALSE;
+}
+
+/** Undo a partly done ecx_setupnic(), the socket, rings and buffer pool of
+ * the port are released, for the primary port also the mutexes.
+ * @param[in] port        = port context struct
+ * @param[in] secondary   = if >0 the redundant port was set up
+ * @return 0
+ */
+static int ecx_setupnic_undo(ecx_portt *port, int secondary)
+{
+   if (secondary)
+   {
+      ecx_closering(&(port->redport->ring));
+      if (port->redport->xsk.umem)
+         ecx_xdp_close(&(port->redport->xsk));
+      ecx_restoretstamp(port->redport->sockhandle, &(port->redport->hwtstamp));
+      if (port->redport->sockhandle >= 0)
+         close(port->redport->sockhandle);
+      port->redport->sockhandle = -1;
+      free(port->redport->pool);
+      port->redport->pool = NULL;
+      port->redstate = ECT_RED_NONE;
+   }
+   else
+   {
+      ecx_closering(&(port->ring));
+      if (port->xsk.umem)
+         ecx_xdp_close(&(port->xsk));
+      ecx_restoretstamp(port->sockhandle, &(port->hwtstamp));
+      if (port->sockhandle >= 0)
+         close(port->sockhandle);
+      port->sockhandle = -1;
+      free(port->pool);
+      port->pool = NULL;
+      pthread_mutex_destroy(&(port->getindex_mutex));
+      pthread_mutex_destroy(&(port->tx_mutex));
+      pthread_mutex_destroy(&(port->rx_mutex));
+   }
+
+   return 0;
+}
+
 /** Basic setup to connect NIC to socket.
  * @param[in] port        = port context struct
  * @param[in] ifname      = Name of NIC device, f.e. "eth0"
  * @param[in] secondary   = if >0 then use secondary stack instead of primary
  * @return >0 if succeeded
+ *
+ * Set port->backend to ECT_PORT_MMAP before calling to use packet rings, or
+ * to ECT_PORT_XDP to use an AF_XDP socket. If the backend can not be set up
+ * the socket falls back to ECT_PORT_SOCKET.
+ *
+ * Set port->timestamping to TRUE before calling to record tx and rx
+ * timestamps of every frame in txtime[] and rxtime[]. The mode obtained is
+ * stored in tstamp, frames over an AF_XDP socket are not timestamped.
+ *
+ * Set port->busypoll to enable SO_BUSY_POLL on the receiving socket, blocking
+ * waits then spin in the driver for up to that many us before sleeping.
  */
 int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
 {
@@ -95,6 +409,10 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
    struct ifreq ifr;
    struct sockaddr_ll sll;
    int *psock;
+   int *tstamp;
+   ec_hwtstampt *hwts;
+   ec_ringt *ring;
+   ec_xskt *xsk;
    pthread_mutexattr_t mutexattr;
 
    rval = 0;
@@ -106,15 +424,36 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
          /* when using secondary socket it is automatically a redundant setup */
          psock = &(port->redport->sockhandle);
          *psock = -1;
+         /* sized like the primary port, which is set up first */
+         port->redport->pool = ecx_poolalloc(ecx_redportpool(port->redport, port->maxbuf, NULL));
+         if (!port->redport->pool)
+         {
+            return 0;
+         }
+         ecx_redportpool(port->redport, port->maxbuf, port->redport->pool);
          port->redstate                   = ECT_RED_DOUBLE;
          port->redport->stack.sock        = &(port->redport->sockhandle);
-         port->redport->stack.txbuf       = &(port->txbuf);
-         port->redport->stack.txbuflength = &(port->txbuflength);
+         port->redport->stack.ring        = &(port->redport->ring);
+         port->redport->stack.xsk         = &(port->redport->xsk);
+         port->redport->stack.maxbuf      = &(port->maxbuf);
+         port->redport->stack.txbuf       = port->txbuf;
+         port->redport->stack.txbuflength = port->txbuflength;
          port->redport->stack.tempbuf     = &(port->redport->tempinbuf);
-         port->redport->stack.rxbuf       = &(port->redport->rxbuf);
-         port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
-         port->redport->stack.rxsa        = &(port->redport->rxsa);
-         ecx_clear_rxbufstat(&(port->redport->rxbufstat[0]));
+         port->redport->stack.rxbuf       = port->redport->rxbuf;
+         for (i = 0; i < port->maxbuf; i++)
+         {
+            port->redport->rxbuf[i] = &(port->redport->rxmem[i][ETH_HEADERSIZE]);
+         }
+         port->redport->stack.rxbufstat   = port->redport->rxbufstat;
+         port->redport->stack.rxsa        = port->redport->rxsa;
+         port->redport->stack.tstamp      = &(port->redport->tstamp);
+         port->redport->stack.txtime      = port->redport->txtime;
+         port->redport->stack.rxtime      = port->redport->rxtime;
+         ecx_clear_rxbufstat(port->redport->rxbufstat, port->maxbuf);
+         tstamp = &(port->redport->tstamp);
+         hwts = &(port->redport->hwtstamp);
+         ring = &(port->redport->ring);
+         xsk = &(port->redport->xsk);
       }
       else
       {
@@ -124,6 +463,21 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
    }
    else
    {
+      if (port->maxbuf <= 0)
+      {
+         port->maxbuf = EC_MAXBUF;
+      }
+      else if (port->maxbuf > EC_NOINDEX)
+      {
+         /* the last index is kept to report that all are in use */
+         port->maxbuf = EC_NOINDEX;
+      }
+      port->pool = ecx_poolalloc(ecx_portpool(port, NULL));
+      if (!port->pool)
+      {
+         return 0;
+      }
+      ecx_portpool(port, port->pool);
       pthread_mutexattr_init(&mutexattr);
       pthread_mutexattr_setprotocol(&mutexattr  , PTHREAD_PRIO_INHERIT);
       pthread_mutex_init(&(port->getindex_mutex), &mutexattr);
@@ -133,19 +487,46 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->lastidx           = 0;
       port->redstate          = ECT_RED_NONE;
       port->stack.sock        = &(port->sockhandle);
-      port->stack.txbuf       = &(port->txbuf);
-      port->stack.txbuflength = &(port->txbuflength);
+      port->stack.ring        = &(port->ring);
+      port->stack.xsk         = &(port->xsk);
+      port->stack.maxbuf      = &(port->maxbuf);
+      port->stack.txbuf       = port->txbuf;
+      port->stack.txbuflength = port->txbuflength;
       port->stack.tempbuf     = &(port->tempinbuf);
-      port->stack.rxbuf       = &(port->rxbuf);
-      port->stack.rxbufstat   = &(port->rxbufstat);
-      port->stack.rxsa        = &(port->rxsa);
-      ecx_clear_rxbufstat(&(port->rxbufstat[0]));
+      port->stack.rxbuf       = port->rxbuf;
+      for (i = 0; i < port->maxbuf; i++)
+      {
+         port->rxbuf[i] = &(port->rxmem[i][ETH_HEADERSIZE]);
+      }
+      for (i = 0; i < EC_MAXBUF; i++)
+      {
+         port->rxqueue[i] = port->rxmem[port->maxbuf + i];
+      }
+      port->stack.rxbufstat   = port->rxbufstat;
+      port->stack.rxsa        = port->rxsa;
+      port->stack.tstamp      = &(port->tstamp);
+      port->stack.txtime      = port->txtime;
+      port->stack.rxtime      = port->rxtime;
+      port->roundtrip         = 0;
+      port->rxowner           = FALSE;
+      port->capture           = NULL;
+      port->rxseq             = 0;
+      port->rxsleepers        = 0;
+      ecx_clear_rxbufstat(port->rxbufstat, port->maxbuf);
       psock = &(port->sockhandle);
+      tstamp = &(port->tstamp);
+      hwts = &(port->hwtstamp);
+      ring = &(port->ring);
+      xsk = &(port->xsk);
    }
+   ring->map = NULL;
+   xsk->umem = NULL;
+   *tstamp = ECT_TSTAMP_NONE;
+   hwts->saved = FALSE;
    /* we use RAW packet socket, with packet type ETH_P_ECAT */
    *psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
    if(*psock < 0)
-      return 0;
+      return ecx_setupnic_undo(port, secondary);
 
    timeout.tv_sec =  0;
    timeout.tv_usec = 1;
@@ -165,19 +546,47 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
    /* set flags of NIC interface, here promiscuous and broadcast */
    ifr.ifr_flags = ifr.ifr_flags | IFF_PROMISC | IFF_BROADCAST;
    r |= ioctl(*psock, SIOCSIFFLAGS, &ifr);
+   /* rings must be set up before the socket is bound */
+   if (port->backend == ECT_PORT_MMAP)
+   {
+      if (!ecx_setupring(*psock, ring, port->maxbuf))
+      {
+         EC_PRINT("ecx_setupnic: no packet ring on %s, using plain socket\n", ifname);
+      }
+   }
    /* bind socket to protocol, in this case RAW EtherCAT */
    sll.sll_family = AF_PACKET;
    sll.sll_ifindex = ifindex;
    sll.sll_protocol = htons(ETH_P_ECAT);
    r |= bind(*psock, (struct sockaddr *)&sll, sizeof(sll));
+   if ((r == 0) && (port->backend == ECT_PORT_XDP))
+   {
+      if (!ecx_xdp_setup(xsk, ifindex))
+      {
+         EC_PRINT("ecx_setupnic: no AF_XDP socket on %s, using plain socket\n", ifname);
+      }
+   }
+   if ((r == 0) && port->timestamping && !xsk->umem)
+   {
+      *tstamp = ecx_setuptstamp(*psock, ifname, ring, hwts);
+   }
+   if ((r == 0) && (port->busypoll > 0))
+   {
+      i = port->busypoll;
+      if (setsockopt(xsk->umem ? xsk->fd : *psock, SOL_SOCKET, SO_BUSY_POLL, &i, sizeof(i)) < 0)
+      {
+         EC_PRINT("ecx_setupnic: SO_BUSY_POLL not permitted on %s\n", ifname);
+      }
+   }
    /* setup ethernet headers in tx buffers so we don't have to repeat it */
-   for (i = 0; i < EC_MAXBUF; i++)
+   for (i = 0; i < port->maxbuf; i++)
    {
       ec_setupheader(&(port->txbuf[i]));
       port->rxbufstat[i] = EC_BUF_EMPTY;
    }
    ec_setupheader(&(port->txbuf2));
    if (r == 0) rval = 1;
+   else ecx_setupnic_undo(port, secondary);
 
    return rval;
 }
@@ -188,10 +597,28 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
  */
 int ecx_closenic(ecx_portt *port)
 {
+   ecx_capture_stop(port);
+   free(port->capture);
+   port->capture = NULL;
+   ecx_closering(&(port->ring));
+   if (port->xsk.umem)
+      ecx_xdp_close(&(port->xsk));
+   ecx_restoretstamp(port->sockhandle, &(port->hwtstamp));
    if (port->sockhandle >= 0)
       close(port->sockhandle);
-   if ((port->redport) && (port->redport->sockhandle >= 0))
-      close(port->redport->sockhandle);
+   if (port->redport)
+   {
+      ecx_closering(&(port->redport->ring));
+      if (port->redport->xsk.umem)
+         ecx_xdp_close(&(port->redport->xsk));
+      ecx_restoretstamp(port->redport->sockhandle, &(port->redport->hwtstamp));
+      if (port->redport->sockhandle >= 0)
+         close(port->redport->sockhandle);
+      free(port->redport->pool);
+      port->redport->pool = NULL;
+   }
+   free(port->pool);
+   port->pool = NULL;
 
    return 0;
 }
@@ -215,39 +642,68 @@ void ec_setupheader(void *p)
 }
 
 /** Get new frame identifier index and allocate corresponding rx buffer.
+ * In dispatcher mode getindex_mutex is not taken, the index is claimed with
+ * a compare-and-swap on its rx buffer status. An index still in use is never
+ * taken, if all are in use EC_NOINDEX is returned.
  * @param[in] port        = port context struct
- * @return new index.
+ * @return new index, EC_NOINDEX if none is free.
  */
 uint8 ecx_getindex(ecx_portt *port)
 {
    uint8 idx;
-   uint8 cnt;
+   int cnt;
+   int empty;
 
-   pthread_mutex_lock( &(port->getindex_mutex) );
+   if (!port->dispatch)
+   {
+      pthread_mutex_lock( &(port->getindex_mutex) );
+   }
 
    idx = port->lastidx + 1;
    /* index can't be larger than buffer array */
-   if (idx >= EC_MAXBUF)
+   if (idx >= port->maxbuf)
    {
       idx = 0;
    }
-   cnt = 0;
-   /* try to find unused index */
-   while ((port->rxbufstat[idx] != EC_BUF_EMPTY) && (cnt < EC_MAXBUF))
+   /* try to find unused index, claim it atomically so no lock is needed */
+   for (cnt = 0; cnt < port->maxbuf; cnt++)
    {
+      empty = EC_BUF_EMPTY;
+      if (__atomic_compare_exchange_n(&(port->rxbufstat[idx]), &empty, EC_BUF_ALLOC,
+                                      FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+      {
+         break;
+      }
       idx++;
-      cnt++;
-      if (idx >= EC_MAXBUF)
+      if (idx >= port->maxbuf)
       {
          idx = 0;
       }
    }
+   if (cnt >= port->maxbuf)
+   {
+      if (!port->dispatch)
+      {
+         pthread_mutex_unlock( &(port->getindex_mutex) );
+      }
+      return EC_NOINDEX;
+   }
    port->rxbufstat[idx] = EC_BUF_ALLOC;
+   port->txtime[idx] = 0;
+   port->rxtime[idx] = 0;
+   port->rxplace[idx] = NULL;
    if (port->redstate != ECT_RED_NONE)
+   {
       port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+      port->redport->txtime[idx] = 0;
+      port->redport->rxtime[idx] = 0;
+   }
    port->lastidx = idx;
 
-   pthread_mutex_unlock( &(port->getindex_mutex) );
+   if (!port->dispatch)
+   {
+      pthread_mutex_unlock( &(port->getindex_mutex) );
+   }
 
    return idx;
 }
@@ -264,6 +720,105 @@ void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat)
       port->redport->rxbufstat[idx] = bufstat;
 }
 
+/** Put frame in next tx ring slot, ecx_kickpkt() has the kernel transmit it.
+ * @param[in] ring        = ring state
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @return len if queued, -1 if all slots are in flight
+ */
+static int ecx_ringput(ec_ringt *ring, const void *buf, int len)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->tx + ring->txhead * ring->framesize);
+   if (hdr->tp_status == TP_STATUS_WRONG_FORMAT)
+   {
+      /* kernel refused the frame, reclaim slot */
+      hdr->tp_status = TP_STATUS_AVAILABLE;
+   }
+   if (hdr->tp_status != TP_STATUS_AVAILABLE)
+   {
+      /* all slots still in flight */
+      return -1;
+   }
+   memcpy((uint8 *)hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll), buf, len);
+   hdr->tp_len = len;
+   __sync_synchronize();
+   hdr->tp_status = TP_STATUS_SEND_REQUEST;
+   ring->txhead++;
+   if (ring->txhead >= ring->framenr)
+   {
+      ring->txhead = 0;
+   }
+
+   return len;
+}
+
+/** Put frame in tx ring or AF_XDP tx queue of stack, or send it directly
+ * on a plain socket. Ring and AF_XDP callers must hold tx_mutex.
+ * @param[in] stack       = stack of socket to use
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @return socket send result
+ */
+static int ecx_putpkt(ec_stackT *stack, const void *buf, int len)
+{
+   if (stack->xsk->umem)
+   {
+      return ecx_xdp_put(stack->xsk, buf, len);
+   }
+   if (stack->ring->map)
+   {
+      return ecx_ringput(stack->ring, buf, len);
+   }
+   return send(*stack->sock, buf, len, 0);
+}
+
+/** Have the kernel transmit all frames put in tx ring or AF_XDP tx queue.
+ * @param[in] stack       = stack of socket to use
+ * @return <0 on error
+ */
+static int ecx_kickpkt(ec_stackT *stack)
+{
+   if (stack->xsk->umem)
+   {
+      return ecx_xdp_kick(stack->xsk);
+   }
+   if (stack->ring->map)
+   {
+      return send(*stack->sock, NULL, 0, MSG_DONTWAIT);
+   }
+   return 0;
+}
+
+/** Transmit frame over socket of stack.
+ * @param[in] stack       = stack of socket to use
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @return socket send result
+ */
+static int ecx_sendpkt(ec_stackT *stack, const void *buf, int len)
+{
+   int rval;
+
+   rval = ecx_putpkt(stack, buf, len);
+   if ((rval > 0) && (ecx_kickpkt(stack) < 0))
+   {
+      rval = -1;
+   }
+
+   return rval;
+}
+
+/** Check if frames are captured.
+ * @param[in] port        = port context struct
+ * @return TRUE if capture is active
+ */
+static int ecx_capturing(ecx_portt *port)
+{
+   return port->capture && __atomic_load_n(&(port->capture->active), __ATOMIC_ACQUIRE);
+}
+
 /** Transmit buffer over socket (non blocking).
  * @param[in] port        = port context struct
  * @param[in] idx         = index in tx buffer array
@@ -283,12 +838,33 @@ int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
    {
       stack = &(port->redport->stack);
    }
-   lp = (*stack->txbuflength)[idx];
-   (*stack->rxbufstat)[idx] = EC_BUF_TX;
-   rval = send(*stack->sock, (*stack->txbuf)[idx], lp, 0);
+   lp = stack->txbuflength[idx];
+   stack->rxbufstat[idx] = EC_BUF_TX;
+   if (ecx_capturing(port))
+   {
+      /* the capture tx ring has a single producer */
+      pthread_mutex_lock( &(port->tx_mutex) );
+      rval = ecx_sendpkt(stack, stack->txbuf[idx], lp);
+      if (rval != -1)
+      {
+         ecx_pcap_push(port->capture, ECT_CAP_TX, stacknumber, stack->txbuf[idx], lp, 0);
+      }
+      pthread_mutex_unlock( &(port->tx_mutex) );
+   }
+   else if (stack->ring->map || stack->xsk->umem)
+   {
+      /* tx slots are shared with other senders */
+      pthread_mutex_lock( &(port->tx_mutex) );
+      rval = ecx_sendpkt(stack, stack->txbuf[idx], lp);
+      pthread_mutex_unlock( &(port->tx_mutex) );
+   }
+   else
+   {
+      rval = ecx_sendpkt(stack, stack->txbuf[idx], lp);
+   }
    if (rval == -1)
    {
-      (*stack->rxbufstat)[idx] = EC_BUF_EMPTY;
+      stack->rxbufstat[idx] = EC_BUF_EMPTY;
    }
 
    return rval;
@@ -322,66 +898,66 @@ int ecx_outframe_red(ecx_portt *port, uint8 idx)
       ehp->sa1 = htons(secMAC[1]);
       /* transmit over secondary socket */
       port->redport->rxbufstat[idx] = EC_BUF_TX;
-      if (send(port->redport->sockhandle, &(port->txbuf2), port->txbuflength2 , 0) == -1)
+      if (ecx_sendpkt(&(port->redport->stack), &(port->txbuf2), port->txbuflength2) == -1)
       {
          port->redport->rxbufstat[idx] = EC_BUF_EMPTY;
       }
+      else if (ecx_capturing(port))
+      {
+         ecx_pcap_push(port->capture, ECT_CAP_TX, 1, port->txbuf2, port->txbuflength2, 0);
+      }
       pthread_mutex_unlock( &(port->tx_mutex) );
    }
 
    return rval;
 }
 
-/** Non blocking read of socket. Put frame in temporary buffer.
+/** Queue buffer for transmission with ecx_flushframes(). Like
+ * ecx_outframe_red() the frame goes out on the primary socket and, in redundant
+ * mode, a dummy frame with the same index goes out on the secondary socket.
  * @param[in] port        = port context struct
- * @param[in] stacknumber = 0=primary 1=secondary stack
- * @return >0 if frame is available and read
+ * @param[in] idx         = index in tx buffer array
+ * @return >0 if queued
  */
-static int ecx_recvpkt(ecx_portt *port, int stacknumber)
+int ecx_queueframe_red(ecx_portt *port, uint8 idx)
 {
-   int lp, bytesrx;
-   ec_stackT *stack;
+   ec_etherheadert *ehp;
 
-   if (!stacknumber)
-   {
-      stack = &(port->stack);
-   }
-   else
+   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
+   /* rewrite MAC source address 1 to primary */
+   ehp->sa1 = htons(priMAC[1]);
+   if (port->txqueued >= port->maxbuf)
    {
-      stack = &(port->redport->stack);
+      /* only happens when indexes are reused, make room */
+      ecx_flushframes(port);
    }
-   lp = sizeof(port->tempinbuf);
-   bytesrx = recv(*stack->sock, (*stack->tempbuf), lp, 0);
-   port->tempinbufs = bytesrx;
+   pthread_mutex_lock( &(port->tx_mutex) );
+   port->rxbufstat[idx] = EC_BUF_TX;
+   if (port->redstate != ECT_RED_NONE)
+      port->redport->rxbufstat[idx] = EC_BUF_TX;
+   port->txqueue[port->txqueued++] = idx;
+   pthread_mutex_unlock( &(port->tx_mutex) );
 
-   return (bytesrx > 0);
+   return 1;
 }
 
-/** Non blocking receive frame function. Uses RX buffer and index to combine
- * read frame with transmitted frame. To compensate for received frames that
- * are out-of-order all frames are stored in their respective indexed buffer.
- * If a frame was placed in the buffer previously, the function retrieves it
- * from that buffer index without calling ec_recvpkt. If the requested index
- * is not already in the buffer it calls ec_recvpkt to fetch it. There are
- * three options now, 1 no frame read, so exit. 2 frame read but other
- * than requested index, store in buffer and exit. 3 frame read with matching
- * index, store in buffer, set completed flag in buffer status and exit.
- *
+/** Transmit queued frames on one socket. Plain sockets send up to EC_MAXBUF
+ * frames per sendmmsg(), rings and AF_XDP put all frames and then kick once,
+ * or more often if the ring fills up.
  * @param[in] port        = port context struct
- * @param[in] idx         = requested index of frame
  * @param[in] stacknumber = 0=primary 1=secondary stack
- * @return Workcounter if a frame is found with corresponding index, otherwise
- * EC_NOFRAME or EC_OTHERFRAME.
+ * @param[in] n           = number of queued frames
+ * @return number of frames sent
  */
-int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+static int ecx_sendqueue(ecx_portt *port, int stacknumber, int n)
 {
-   uint16  l;
-   int     rval;
-   uint8   idxf;
-   ec_etherheadert *ehp;
-   ec_comt *ecp;
+   struct mmsghdr msg[EC_MAXBUF];
+   struct iovec iov[EC_MAXBUF][3];
    ec_stackT *stack;
-   ec_bufT *rxbuf;
+   ec_comt *datagramP;
+   ec_etherheadert *ehp;
+   int i, j, m, sent, rval, kicked;
+   uint8 idx;
 
    if (!stacknumber)
    {
@@ -390,71 +966,735 @@ int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
    else
    {
       stack = &(port->redport->stack);
+      ehp = (ec_etherheadert *)&(port->txbuf2);
+      /* rewrite MAC source address 1 to secondary */
+      ehp->sa1 = htons(secMAC[1]);
    }
-   rval = EC_NOFRAME;
-   rxbuf = &(*stack->rxbuf)[idx];
-   /* check if requested index is already in buffer ? */
-   if ((idx < EC_MAXBUF) && ((*stack->rxbufstat)[idx] == EC_BUF_RCVD))
+   datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
+   sent = 0;
+   if (stack->ring->map || stack->xsk->umem)
    {
-      l = (*rxbuf)[0] + ((uint16)((*rxbuf)[1] & 0x0f) << 8);
-      /* return WKC */
-      rval = ((*rxbuf)[l] + ((uint16)(*rxbuf)[l + 1] << 8));
-      /* mark as completed */
-      (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+      kicked = 0;
+      while (sent < n)
+      {
+         idx = port->txqueue[sent];
+         if (!stacknumber)
+         {
+            rval = ecx_putpkt(stack, port->txbuf[idx], port->txbuflength[idx]);
+         }
+         else
+         {
+            /* put copies the frame, so the dummy can be reused */
+            datagramP->index = idx;
+            rval = ecx_putpkt(stack, port->txbuf2, port->txbuflength2);
+         }
+         if (rval == -1)
+         {
+            /* ring full, send what is in it and try once more */
+            if ((kicked == sent) || (ecx_kickpkt(stack) < 0))
+               break;
+            kicked = sent;
+            continue;
+         }
+         sent++;
+      }
+      if ((sent > kicked) && (ecx_kickpkt(stack) < 0))
+      {
+         sent = kicked;
+      }
    }
    else
    {
-      pthread_mutex_lock(&(port->rx_mutex));
-      /* non blocking call to retrieve frame from socket */
-      if (ecx_recvpkt(port, stacknumber))
+      /* in chunks of EC_MAXBUF frames to bound the stack used */
+      while (sent < n)
       {
-         rval = EC_OTHERFRAME;
-         ehp =(ec_etherheadert*)(stack->tempbuf);
-         /* check if it is an EtherCAT frame */
-         if (ehp->etype == htons(ETH_P_ECAT))
+         m = n - sent;
+         if (m > EC_MAXBUF)
+            m = EC_MAXBUF;
+         memset(msg, 0, sizeof(msg[0]) * m);
+         for (j = 0; j < m; j++)
          {
-            ecp =(ec_comt*)(&(*stack->tempbuf)[ETH_HEADERSIZE]);
-            l = etohs(ecp->elength) & 0x0fff;
-            idxf = ecp->index;
-            /* found index equals requested index ? */
-            if (idxf == idx)
+            i = sent + j;
+            idx = port->txqueue[i];
+            if (!stacknumber)
             {
-               /* yes, put it in the buffer array (strip ethernet header) */
-               memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
-               /* return WKC */
-               rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
-               /* mark as completed */
-               (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
-               /* store MAC source word 1 for redundant routing info */
-               (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+               iov[j][0].iov_base = port->txbuf[idx];
+               iov[j][0].iov_len = port->txbuflength[idx];
+               msg[j].msg_hdr.msg_iovlen = 1;
             }
             else
             {
-               /* check if index exist and someone is waiting for it */
-               if (idxf < EC_MAXBUF && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
-               {
-                  rxbuf = &(*stack->rxbuf)[idxf];
-                  /* put it in the buffer array (strip ethernet header) */
-                  memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idxf] - ETH_HEADERSIZE);
-                  /* mark as received */
-                  (*stack->rxbufstat)[idxf] = EC_BUF_RCVD;
-                  (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
-               }
-               else
-               {
-                  /* strange things happened */
-               }
+               /* dummy frame for secondary socket, index taken from the queue */
+               iov[j][0].iov_base = port->txbuf2;
+               iov[j][0].iov_len = ETH_HEADERSIZE + offsetof(ec_comt, index);
+               iov[j][1].iov_base = &(port->txqueue[i]);
+               iov[j][1].iov_len = sizeof(port->txqueue[i]);
+               iov[j][2].iov_base = &(port->txbuf2[iov[j][0].iov_len + 1]);
+               iov[j][2].iov_len = port->txbuflength2 - iov[j][0].iov_len - 1;
+               msg[j].msg_hdr.msg_iovlen = 3;
             }
+            msg[j].msg_hdr.msg_iov = iov[j];
+         }
+         j = 0;
+         while (j < m)
+         {
+            rval = sendmmsg(*stack->sock, &msg[j], m - j, 0);
+            if (rval <= 0)
+               break;
+            j += rval;
          }
+         sent += j;
+         if (j < m)
+            break;
       }
-      pthread_mutex_unlock( &(port->rx_mutex) );
-
    }
-
-   /* WKC if matching frame found */
-   return rval;
-}
-
+   if (ecx_capturing(port))
+   {
+      for (i = 0; i < sent; i++)
+      {
+         idx = port->txqueue[i];
+         if (!stacknumber)
+         {
+            ecx_pcap_push(port->capture, ECT_CAP_TX, 0, port->txbuf[idx], port->txbuflength[idx], 0);
+         }
+         else
+         {
+            datagramP->index = idx;
+            ecx_pcap_push(port->capture, ECT_CAP_TX, 1, port->txbuf2, port->txbuflength2, 0);
+         }
+      }
+   }
+   /* frames not sent will not return */
+   for (i = sent; i < n; i++)
+   {
+      stack->rxbufstat[port->txqueue[i]] = EC_BUF_EMPTY;
+   }
+
+   return sent;
+}
+
+/** Transmit all frames queued with ecx_queueframe_red(), on the primary and
+ * if in redundant mode also on the secondary socket.
+ * @param[in] port        = port context struct
+ * @return number of frames sent on primary socket
+ */
+int ecx_flushframes(ecx_portt *port)
+{
+   int n, rval;
+
+   pthread_mutex_lock( &(port->tx_mutex) );
+   n = port->txqueued;
+   rval = 0;
+   if (n > 0)
+   {
+      rval = ecx_sendqueue(port, 0, n);
+      if (port->redstate != ECT_RED_NONE)
+      {
+         ecx_sendqueue(port, 1, n);
+      }
+   }
+   port->txqueued = 0;
+   pthread_mutex_unlock( &(port->tx_mutex) );
+
+   return rval;
+}
+
+/** Have the data of the first datagram of the frame sent with index idx
+ * copied straight from the packet ring or UMEM to data when the frame comes
+ * back, instead of into the rx buffer and from there by the caller. Holds
+ * until the index is allocated again. The plain socket backend already
+ * receives into the rx buffer without a copy and redundant mode merges both
+ * rx buffers, so in these cases nothing is placed.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame, set before it is transmitted
+ * @param[in] data        = where the datagram data goes
+ * @param[in] length      = length of datagram data
+ * @return TRUE if the data will be placed, FALSE if the caller has to copy
+ * it from the rx buffer
+ */
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length)
+{
+   if ((port->redstate != ECT_RED_NONE) || (!port->ring.map && !port->xsk.umem) ||
+       ((int)(ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE) + length > EC_BUFSIZE))
+   {
+      return FALSE;
+   }
+   port->rxplacelen[idx] = length;
+   port->rxplace[idx] = data;
+
+   return TRUE;
+}
+
+/** Look at frame in next rx ring slot if the kernel has filled it. The slot
+ * stays with the caller until ecx_ringrelease().
+ * @param[in] ring        = ring state
+ * @param[out] frame      = frame in the slot
+ * @param[out] rxtime     = receive timestamp of frame in ns
+ * @return number of bytes received, 0 if no frame available
+ */
+static int ecx_ringpeek(ec_ringt *ring, const uint8 **frame, int64 *rxtime)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->rx + ring->rxhead * ring->framesize);
+   if (!(hdr->tp_status & TP_STATUS_USER))
+   {
+      return 0;
+   }
+   __sync_synchronize();
+   *frame = (uint8 *)hdr + hdr->tp_mac;
+   *rxtime = (int64)hdr->tp_sec * 1000000000 + hdr->tp_nsec;
+
+   return hdr->tp_snaplen;
+}
+
+/** Hand the rx slot taken with ecx_ringpeek() back to the kernel.
+ * @param[in] ring        = ring state
+ */
+static void ecx_ringrelease(ec_ringt *ring)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->rx + ring->rxhead * ring->framesize);
+   __sync_synchronize();
+   /* hand slot back to kernel */
+   hdr->tp_status = TP_STATUS_KERNEL;
+   ring->rxhead++;
+   if (ring->rxhead >= ring->framenr)
+   {
+      ring->rxhead = 0;
+   }
+}
+
+/** File a received frame in the rx buffer of its index. The frame is only
+ * accepted when its index is the requested one or someone is waiting for it.
+ * @param[in] stack       = rx and tx stack of the socket
+ * @param[in] idx         = requested index of frame
+ * @param[in,out] frame   = received frame including ethernet header, when
+ *                          filed it is swapped with the previous rx buffer
+ * @param[in] rxtime      = receive timestamp of frame in ns, 0 if none
+ * @return TRUE if frame is stored in the rx buffer
+ */
+static int ecx_fileframe(ec_stackT *stack, uint8 idx, uint8 **frame, int64 rxtime)
+{
+   const ec_etherheadert *ehp;
+   const ec_comt *ecp;
+   uint8 *rxbuf;
+   uint8 idxf;
+
+   ehp = (const ec_etherheadert *)*frame;
+   /* check if it is an EtherCAT frame */
+   if (ehp->etype != htons(ETH_P_ECAT))
+   {
+      return FALSE;
+   }
+   ecp = (const ec_comt *)&(*frame)[ETH_HEADERSIZE];
+   idxf = ecp->index;
+   /* check if index exist and it is requested or someone is waiting for it */
+   if ((idxf >= *stack->maxbuf) ||
+       ((idxf != idx) && (stack->rxbufstat[idxf] != EC_BUF_TX)))
+   {
+      /* strange things happened */
+      return FALSE;
+   }
+   /* store MAC source word 1 for redundant routing info */
+   stack->rxsa[idxf] = ntohs(ehp->sa1);
+   stack->rxtime[idxf] = rxtime;
+   /* swap it into the buffer array (strip ethernet header), the old buffer
+    * takes its place in the receive queue */
+   rxbuf = stack->rxbuf[idxf];
+   stack->rxbuf[idxf] = &(*frame)[ETH_HEADERSIZE];
+   *frame = rxbuf - ETH_HEADERSIZE;
+   /* mark as received, last so a lock-free waiter sees the complete buffer */
+   __atomic_store_n(&stack->rxbufstat[idxf], EC_BUF_RCVD, __ATOMIC_SEQ_CST);
+
+   return TRUE;
+}
+
+/** Get timestamp from the SCM_TIMESTAMPING control message of a received
+ * frame or error queue message.
+ * @param[in] msg         = received message header
+ * @param[in] tstamp      = timestamping mode of socket
+ * @return timestamp in ns, 0 if none
+ */
+static int64 ecx_cmsgtime(struct msghdr *msg, int tstamp)
+{
+   struct cmsghdr *cmsg;
+   struct scm_timestamping tss;
+   struct timespec *ts;
+
+   for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+   {
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+      {
+         memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+         /* ts[0] is the software, ts[2] the raw hardware timestamp */
+         ts = (tstamp == ECT_TSTAMP_HARDWARE) ? &tss.ts[2] : &tss.ts[0];
+         return (int64)ts->tv_sec * 1000000000 + ts->tv_nsec;
+      }
+   }
+
+   return 0;
+}
+
+/** Time of a received frame for the capture. Transmitted frames are stamped
+ * with CLOCK_REALTIME when they are pushed, only a software timestamp is on
+ * the same clock. A raw hardware timestamp is on the PHC clock, so then the
+ * received frame is stamped when pushed as well.
+ * @param[in] stack       = rx and tx stack of the socket
+ * @param[in] rxtime      = timestamp of the frame, 0 if none
+ * @return time for ecx_pcap_push(), 0 to take the current time
+ */
+static int64 ecx_captime(ec_stackT *stack, int64 rxtime)
+{
+   return (*stack->tstamp == ECT_TSTAMP_SOFTWARE) ? rxtime : 0;
+}
+
+/** Read transmit timestamps from the socket error queue. The kernel returns
+ * each sent frame there with its timestamp, the frame index tells which
+ * txtime[] it belongs to. Only the frame header is read, into a local
+ * buffer, so a thread that does not own the socket may drain the queue too.
+ * @param[in] stack       = rx and tx stack of the socket
+ */
+static void ecx_recvtxtime(ec_stackT *stack)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   uint8 control[EC_CMSGSIZE];
+   uint8 frame[ETH_HEADERSIZE + sizeof(ec_comt)];
+   const ec_etherheadert *ehp;
+   const ec_comt *ecp;
+   int i, bytesrx;
+   int64 txtime;
+
+   for (i = 0; i < *stack->maxbuf; i++)
+   {
+      memset(&msg, 0, sizeof(msg));
+      iov.iov_base = frame;
+      iov.iov_len = sizeof(frame);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      bytesrx = recvmsg(*stack->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+      if (bytesrx <= 0)
+      {
+         break;
+      }
+      ehp = (const ec_etherheadert *)frame;
+      ecp = (const ec_comt *)&frame[ETH_HEADERSIZE];
+      txtime = ecx_cmsgtime(&msg, *stack->tstamp);
+      if ((bytesrx >= (int)(ETH_HEADERSIZE + sizeof(ec_comt))) &&
+          (ehp->etype == htons(ETH_P_ECAT)) && (ecp->index < *stack->maxbuf) && txtime)
+      {
+         stack->txtime[ecp->index] = txtime;
+      }
+   }
+}
+
+/** Copy a frame out of a packet ring slot or UMEM frame into a receive queue
+ * buffer. When the data of its first datagram has a place set with
+ * ecx_setrxplace() and someone waits for the frame, that data is copied
+ * straight to its place and the buffer only gets the frame around it, so
+ * header, WKC and further datagrams stay at their usual offsets.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[out] buf        = receive queue buffer
+ * @param[in] frame       = received frame including ethernet header
+ * @param[in] len         = frame length
+ */
+static void ecx_rxcopy(ecx_portt *port, int stacknumber, uint8 *buf, const uint8 *frame, int len)
+{
+   const ec_etherheadert *ehp;
+   uint8 *place;
+   int hdr, plen;
+   uint8 idxf;
+
+   hdr = ETH_HEADERSIZE + EC_HEADERSIZE;
+   ehp = (const ec_etherheadert *)frame;
+   place = NULL;
+   plen = 0;
+   if (!stacknumber && (len >= hdr) && (ehp->etype == htons(ETH_P_ECAT)))
+   {
+      idxf = ((const ec_comt *)&frame[ETH_HEADERSIZE])->index;
+      if ((idxf < port->maxbuf) &&
+          (__atomic_load_n(&(port->rxbufstat[idxf]), __ATOMIC_SEQ_CST) == EC_BUF_TX))
+      {
+         place = port->rxplace[idxf];
+         plen = port->rxplacelen[idxf];
+      }
+   }
+   if (place && (len >= hdr + plen))
+   {
+      memcpy(buf, frame, hdr);
+      memcpy(place, &frame[hdr], plen);
+      memcpy(&buf[hdr + plen], &frame[hdr + plen], len - hdr - plen);
+   }
+   else
+   {
+      memcpy(buf, frame, len);
+   }
+}
+
+/** Non blocking read of all frames pending on the socket, up to EC_MAXBUF.
+ * The plain socket is drained with a single recvmmsg() call, the rings are
+ * read until empty. Every frame is filed in the rx buffer of its index, so
+ * a single call can complete all frames outstanding on the socket.
+ * Must be called with rx_mutex held or, in dispatcher mode, as rxowner;
+ * rxqueue is shared by both stacks.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[in] block       = TRUE to let the plain socket wait for the first
+ *                          frame up to its receive timeout, which the kernel
+ *                          rounds up to a scheduler tick
+ * @return number of frames read
+ */
+static int ecx_recvpkts(ecx_portt *port, uint8 idx, int stacknumber, int block)
+{
+   struct mmsghdr msgs[EC_MAXBUF];
+   struct iovec iov[EC_MAXBUF];
+   uint8 control[EC_MAXBUF][EC_CMSGSIZE];
+   int64 rxtime[EC_MAXBUF];
+   int rxlen[EC_MAXBUF];
+   int i, n, lp, bytesrx;
+   const uint8 *frame;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   lp = EC_BUFSIZE;
+   n = 0;
+   if (stack->xsk->umem || stack->ring->map)
+   {
+      /* ring slots are taken without a syscall, read until none left */
+      do
+      {
+         if (stack->xsk->umem)
+         {
+            bytesrx = ecx_xdp_peek(stack->xsk, &frame);
+            rxtime[n] = 0;
+         }
+         else
+         {
+            bytesrx = ecx_ringpeek(stack->ring, &frame, &rxtime[n]);
+         }
+         if (bytesrx > 0)
+         {
+            if (bytesrx > lp)
+            {
+               bytesrx = lp;
+            }
+            if (ecx_capturing(port))
+            {
+               ecx_pcap_push(port->capture, ECT_CAP_RX, stacknumber, frame, bytesrx, ecx_captime(stack, rxtime[n]));
+            }
+            ecx_rxcopy(port, stacknumber, port->rxqueue[n], frame, bytesrx);
+            if (stack->xsk->umem)
+            {
+               ecx_xdp_release(stack->xsk);
+            }
+            else
+            {
+               ecx_ringrelease(stack->ring);
+            }
+         }
+         rxlen[n] = bytesrx;
+      } while ((bytesrx > 0) && (++n < EC_MAXBUF));
+   }
+   else
+   {
+      memset(msgs, 0, sizeof(msgs));
+      for (i = 0; i < EC_MAXBUF; i++)
+      {
+         iov[i].iov_base = port->rxqueue[i];
+         iov[i].iov_len = lp;
+         msgs[i].msg_hdr.msg_iov = &iov[i];
+         msgs[i].msg_hdr.msg_iovlen = 1;
+         if (*stack->tstamp)
+         {
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = EC_CMSGSIZE;
+         }
+      }
+      /* wait for the first frame as recv() would, take the rest if present */
+      n = recvmmsg(*stack->sock, msgs, EC_MAXBUF, block ? MSG_WAITFORONE : MSG_DONTWAIT, NULL);
+      if (n < 0)
+      {
+         n = 0;
+      }
+      for (i = 0; i < n; i++)
+      {
+         rxtime[i] = *stack->tstamp ? ecx_cmsgtime(&msgs[i].msg_hdr, *stack->tstamp) : 0;
+         rxlen[i] = msgs[i].msg_len;
+         if (ecx_capturing(port))
+         {
+            ecx_pcap_push(port->capture, ECT_CAP_RX, stacknumber, port->rxqueue[i], rxlen[i], ecx_captime(stack, rxtime[i]));
+         }
+      }
+   }
+   for (i = 0; i < n; i++)
+   {
+      ecx_fileframe(stack, idx, &(port->rxqueue[i]), rxtime[i]);
+   }
+   /* a frame came back so its transmit timestamp is queued by now */
+   if ((n > 0) && *stack->tstamp)
+   {
+      ecx_recvtxtime(stack);
+   }
+   port->tempinbufs = n;
+
+   return n;
+}
+
+/** Check if frame with index is received and not yet taken.
+ * @param[in] stack       = rx and tx stack of the socket
+ * @param[in] idx         = index of frame
+ * @return TRUE if frame is in the rx buffer
+ */
+static int ecx_isrcvd(ec_stackT *stack, uint8 idx)
+{
+   return (idx < *stack->maxbuf) &&
+          (__atomic_load_n(&stack->rxbufstat[idx], __ATOMIC_SEQ_CST) == EC_BUF_RCVD);
+}
+
+/** Take received frame, mark it as completed.
+ * @param[in] stack       = rx and tx stack of the socket
+ * @param[in] idx         = index of frame
+ * @return Workcounter of frame
+ */
+static int ecx_completeframe(ec_stackT *stack, uint8 idx)
+{
+   uint16 l;
+   uint8 *rxbuf;
+
+   rxbuf = stack->rxbuf[idx];
+   l = rxbuf[0] + ((uint16)(rxbuf[1] & 0x0f) << 8);
+   /* mark as completed */
+   stack->rxbufstat[idx] = EC_BUF_COMPLETE;
+   /* return WKC */
+   return (rxbuf[l] + ((uint16)rxbuf[l + 1] << 8));
+}
+
+/** Receive frame, see ecx_inframe().
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[in] block       = TRUE to let the socket wait briefly for a frame
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME or EC_OTHERFRAME.
+ */
+static int ecx_readframe(ecx_portt *port, uint8 idx, int stacknumber, int block)
+{
+   int     rval;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   rval = EC_NOFRAME;
+   /* check if requested index is already in buffer ? */
+   if (ecx_isrcvd(stack, idx))
+   {
+      rval = ecx_completeframe(stack, idx);
+   }
+   else if (port->dispatch)
+   {
+      /* only the thread that becomes rxowner reads the socket, the frames it
+       * files for other threads are picked up from the buffer by them */
+      if (!__atomic_exchange_n(&(port->rxowner), TRUE, __ATOMIC_ACQUIRE))
+      {
+         if (ecx_recvpkts(port, idx, stacknumber, block))
+         {
+            rval = EC_OTHERFRAME;
+         }
+         __atomic_store_n(&(port->rxowner), FALSE, __ATOMIC_SEQ_CST);
+         /* let threads sleeping in ecx_pollpkt() look for their frame */
+         if (__atomic_load_n(&(port->rxsleepers), __ATOMIC_SEQ_CST))
+         {
+            __atomic_add_fetch(&(port->rxseq), 1, __ATOMIC_SEQ_CST);
+            syscall(SYS_futex, &(port->rxseq), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+         }
+      }
+      /* found frame with requested index ? */
+      if (ecx_isrcvd(stack, idx))
+      {
+         rval = ecx_completeframe(stack, idx);
+      }
+   }
+   else
+   {
+      pthread_mutex_lock(&(port->rx_mutex));
+      /* non blocking call to retrieve all pending frames from socket */
+      if (ecx_recvpkts(port, idx, stacknumber, block))
+      {
+         rval = EC_OTHERFRAME;
+         /* found frame with requested index ? */
+         if (ecx_isrcvd(stack, idx))
+         {
+            rval = ecx_completeframe(stack, idx);
+         }
+      }
+      pthread_mutex_unlock( &(port->rx_mutex) );
+
+   }
+   if ((rval > EC_NOFRAME) && !stacknumber && port->txtime[idx] && port->rxtime[idx])
+   {
+      port->roundtrip = port->rxtime[idx] - port->txtime[idx];
+   }
+
+   /* WKC if matching frame found */
+   return rval;
+}
+
+/** Non blocking receive frame function. Uses RX buffer and index to combine
+ * read frame with transmitted frame. To compensate for received frames that
+ * are out-of-order all frames are stored in their respective indexed buffer.
+ * If a frame was placed in the buffer previously, the function retrieves it
+ * from that buffer index without calling ecx_recvpkts. If the requested index
+ * is not already in the buffer it calls ecx_recvpkts to fetch all pending
+ * frames, each stored in the buffer of its own index. There are three options
+ * now, 1 no frame read, so exit. 2 frames read but none with the requested
+ * index, exit. 3 frame read with matching index, set completed flag in buffer
+ * status and exit.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME or EC_OTHERFRAME.
+ */
+int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   return ecx_readframe(port, idx, stacknumber, (port->rxwait == ECT_RXWAIT_SPIN));
+}
+
+/** Sleep until a frame is pending on the socket(s) or the timer expires.
+ * The sleep is cut into EC_POLLSLICE pieces, see there. In dispatcher mode a
+ * thread that finds another thread reading the socket sleeps until that
+ * thread gives up rxowner instead.
+ * @param[in] port        = port context struct
+ * @param[in] primary     = TRUE to wait on the primary socket
+ * @param[in] secondary   = TRUE to wait on the secondary socket
+ * @param[in] timer       = absolute timeout time
+ */
+static void ecx_pollpkt(ecx_portt *port, int primary, int secondary, osal_timert *timer)
+{
+   struct pollfd fds[2];
+   ec_stackT *stacks[2];
+   struct timespec now, ts;
+   int64 remain, end;
+   nfds_t n, i;
+   int seq, drained;
+
+   n = 0;
+   if (primary)
+   {
+      fds[n].fd = port->xsk.umem ? port->xsk.fd : port->sockhandle;
+      fds[n].events = POLLIN;
+      stacks[n] = &(port->stack);
+      n++;
+   }
+   if (secondary)
+   {
+      fds[n].fd = port->redport->xsk.umem ? port->redport->xsk.fd : port->redport->sockhandle;
+      fds[n].events = POLLIN;
+      stacks[n] = &(port->redport->stack);
+      n++;
+   }
+   /* osal timers on linux run on CLOCK_MONOTONIC */
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   remain = ((int64)timer->stop_time.sec - now.tv_sec) * 1000000 +
+            (int64)timer->stop_time.usec - now.tv_nsec / 1000;
+   if ((n == 0) || (remain <= 0))
+   {
+      return;
+   }
+   if (remain > EC_POLLSLICE)
+   {
+      remain = EC_POLLSLICE;
+   }
+   ts.tv_sec = 0;
+   ts.tv_nsec = remain * 1000;
+   if (port->dispatch)
+   {
+      seq = __atomic_load_n(&(port->rxseq), __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&(port->rxsleepers), 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&(port->rxowner), __ATOMIC_SEQ_CST))
+      {
+         syscall(SYS_futex, &(port->rxseq), FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+         n = 0;
+      }
+      __atomic_sub_fetch(&(port->rxsleepers), 1, __ATOMIC_SEQ_CST);
+      if (n == 0)
+      {
+         return;
+      }
+   }
+   /* queued transmit timestamps make ppoll() return POLLERR at once, so they
+    * are read before sleeping and whenever they end the sleep */
+   for (i = 0; i < n; i++)
+   {
+      if (*stacks[i]->tstamp)
+      {
+         ecx_recvtxtime(stacks[i]);
+      }
+   }
+   end = ((int64)now.tv_sec * 1000000000) + now.tv_nsec + ts.tv_nsec;
+   while (ppoll(fds, n, &ts, NULL) > 0)
+   {
+      drained = FALSE;
+      for (i = 0; i < n; i++)
+      {
+         if (fds[i].revents & POLLIN)
+         {
+            return;
+         }
+         if ((fds[i].revents & POLLERR) && *stacks[i]->tstamp)
+         {
+            ecx_recvtxtime(stacks[i]);
+            drained = TRUE;
+         }
+      }
+      if (!drained)
+      {
+         return;
+      }
+      /* sleep on for the rest of the slice */
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remain = end - (((int64)now.tv_sec * 1000000000) + now.tv_nsec);
+      if (remain <= 0)
+      {
+         return;
+      }
+      ts.tv_nsec = remain;
+   }
+}
+
+/** Exchange primary and secondary rx buffer of index, no data is copied.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in buffer array
+ */
+static void ecx_swaprxbuf(ecx_portt *port, uint8 idx)
+{
+   uint8 *rxbuf;
+
+   rxbuf = port->rxbuf[idx];
+   port->rxbuf[idx] = port->redport->rxbuf[idx];
+   port->redport->rxbuf[idx] = rxbuf;
+}
+
 /** Blocking redundant receive frame function. If redundant mode is not active then
  * it skips the secondary stack and redundancy functions. In redundant mode it waits
  * for both (primary and secondary) frames to come in. The result goes in an decision
@@ -473,21 +1713,29 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
    int wkc  = EC_NOFRAME;
    int wkc2 = EC_NOFRAME;
    int primrx, secrx;
+   int block;
 
    /* if not in redundant mode then always assume secondary is OK */
    if (port->redstate == ECT_RED_NONE)
       wkc2 = 0;
    do
    {
+      /* with the time up only take what is there, a blocking read would
+       * overrun the timeout by up to a scheduler tick */
+      block = (port->rxwait == ECT_RXWAIT_SPIN) && !osal_timer_is_expired(timer);
       /* only read frame if not already in */
       if (wkc <= EC_NOFRAME)
-         wkc  = ecx_inframe(port, idx, 0);
+         wkc  = ecx_readframe(port, idx, 0, block);
       /* only try secondary if in redundant mode */
       if (port->redstate != ECT_RED_NONE)
       {
          /* only read frame if not already in */
          if (wkc2 <= EC_NOFRAME)
-            wkc2 = ecx_inframe(port, idx, 1);
+            wkc2 = ecx_readframe(port, idx, 1, block);
+      }
+      if ((port->rxwait == ECT_RXWAIT_POLL) && ((wkc <= EC_NOFRAME) || (wkc2 <= EC_NOFRAME)))
+      {
+         ecx_pollpkt(port, (wkc <= EC_NOFRAME), (wkc2 <= EC_NOFRAME), timer);
       }
    /* wait for both frames to arrive or timeout */
    } while (((wkc <= EC_NOFRAME) || (wkc2 <= EC_NOFRAME)) && !osal_timer_is_expired(timer));
@@ -505,8 +1753,8 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
       /* normal situation in redundant mode */
       if ( ((primrx == RX_SEC) && (secrx == RX_PRIM)) )
       {
-         /* copy secondary buffer to primary */
-         memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
+         /* swap secondary buffer to primary */
+         ecx_swaprxbuf(port, idx);
          wkc = wkc2;
       }
       /* primary socket got nothing or primary frame, and secondary socket got secondary frame */
@@ -520,7 +1768,7 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
          if ( (primrx == RX_PRIM) && (secrx == RX_SEC) )
          {
             /* copy primary rx to tx buffer */
-            memcpy(&(port->txbuf[idx][ETH_HEADERSIZE]), &(port->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
+            memcpy(&(port->txbuf[idx][ETH_HEADERSIZE]), port->rxbuf[idx], port->txbuflength[idx] - ETH_HEADERSIZE);
          }
          osal_timer_start (&timer2, EC_TIMEOUTRET);
          /* resend secondary tx */
@@ -529,11 +1777,15 @@ static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
          {
             /* retrieve frame */
             wkc2 = ecx_inframe(port, idx, 1);
+            if ((port->rxwait == ECT_RXWAIT_POLL) && (wkc2 <= EC_NOFRAME))
+            {
+               ecx_pollpkt(port, FALSE, TRUE, &timer2);
+            }
          } while ((wkc2 <= EC_NOFRAME) && !osal_timer_is_expired(&timer2));
          if (wkc2 > EC_NOFRAME)
          {
-            /* copy secondary result to primary rx buffer */
-            memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
+            /* swap secondary result to primary rx buffer */
+            ecx_swaprxbuf(port, idx);
             wkc = wkc2;
          }
       }
@@ -600,6 +1852,45 @@ int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
    return wkc;
 }
 
+/** Start capturing all frames sent and received on the port to a pcapng
+ * file. Frames are copied into a ring and written by a background thread,
+ * frames that do not fit in the ring are dropped rather than delaying the
+ * caller. Timestamps are those of SO_TIMESTAMPING when enabled, otherwise
+ * the time the frame passed the driver.
+ * @param[in] port        = port context struct
+ * @param[in] filename    = pcapng file to create
+ * @return >0 if capture started
+ */
+int ecx_capture_start(ecx_portt *port, const char *filename)
+{
+   if (!port->capture)
+   {
+      port->capture = calloc(1, sizeof(ec_capturet));
+      if (!port->capture)
+      {
+         return 0;
+      }
+   }
+   if (port->capture->active)
+   {
+      return 0;
+   }
+
+   return ecx_pcap_open(port->capture, filename);
+}
+
+/** Stop capturing and close the pcapng file. The capture state is kept until
+ * ecx_closenic() as other threads may still be copying a frame into it.
+ * @param[in] port        = port context struct
+ */
+void ecx_capture_stop(ecx_portt *port)
+{
+   if (port->capture)
+   {
+      ecx_pcap_close(port->capture);
+   }
+}
+
 #ifdef EC_VER1
 int ec_setupnic(const char *ifname, int secondary)
 {
@@ -631,6 +1922,16 @@ int ec_outframe_red(uint8 idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_queueframe_red(uint8 idx)
+{
+   return ecx_queueframe_red(&ecx_port, idx);
+}
+
+int ec_flushframes(void)
+{
+   return ecx_flushframes(&ecx_port);
+}
+
 int ec_inframe(uint8 idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -645,4 +1946,14 @@ int ec_srconfirm(uint8 idx, int timeout)
 {
    return ecx_srconfirm(&ecx_port, idx, timeout);
 }
+
+int ec_capture_start(const char *filename)
+{
+   return ecx_capture_start(&ecx_port, filename);
+}
+
+void ec_capture_stop(void)
+{
+   ecx_capture_stop(&ecx_port);
+}
 #endif
@@ -17,24 +17,204 @@ extern "C"
 #endif
 
 #include <pthread.h>
+#include <stddef.h>
+#include <net/if.h>
+#include <linux/net_tstamp.h>
+
+/** Socket backends, select by setting ecx_portt.backend before ecx_setupnic() */
+enum
+{
+   /** Plain recv() and send() on the raw socket, one syscall per frame */
+   ECT_PORT_SOCKET,
+   /** PACKET_MMAP rx and tx rings shared with the kernel */
+   ECT_PORT_MMAP,
+   /** AF_XDP socket, zero-copy if the driver supports it, else copy mode */
+   ECT_PORT_XDP
+};
+
+/** Receive wait modes, select by setting ecx_portt.rxwait */
+enum
+{
+   /** Retry the non blocking receive until a frame arrives, lowest latency */
+   ECT_RXWAIT_SPIN,
+   /** Sleep in ppoll() until a frame arrives or the timeout expires */
+   ECT_RXWAIT_POLL
+};
+
+/** Packet timestamping, resulting mode when ecx_portt.timestamping is set */
+enum
+{
+   /** No timestamps available */
+   ECT_TSTAMP_NONE,
+   /** Kernel timestamps, taken in the network stack at send and receive */
+   ECT_TSTAMP_SOFTWARE,
+   /** NIC hardware timestamps, taken when the frame passes the MAC */
+   ECT_TSTAMP_HARDWARE
+};
+
+/** NIC wide hardware timestamping config as found by ecx_setupnic(), put
+ * back by ecx_closenic() */
+typedef struct
+{
+   /** TRUE if the config was changed and is to be put back */
+   int         saved;
+   /** interface the config belongs to */
+   char        ifname[IFNAMSIZ];
+   /** config before hardware timestamping was enabled */
+   struct hwtstamp_config config;
+} ec_hwtstampt;
+
+/** number of UMEM frames for AF_XDP rx and for AF_XDP tx */
+#define EC_XDPFRAMES EC_MAXBUFPOOL
+
+/** mmap'd PACKET_RX_RING / PACKET_TX_RING of one socket */
+typedef struct
+{
+   /** mapped area, rx ring followed by tx ring, NULL if not in use */
+   uint8       *map;
+   /** total length of mapped area */
+   size_t      maplen;
+   /** first rx frame slot */
+   uint8       *rx;
+   /** first tx frame slot */
+   uint8       *tx;
+   /** size of one frame slot */
+   int         framesize;
+   /** number of frame slots per ring */
+   int         framenr;
+   /** next rx slot to be consumed */
+   int         rxhead;
+   /** next tx slot to be filled */
+   int         txhead;
+} ec_ringt;
+
+/** AF_XDP ring, producer and consumer shared with the kernel */
+typedef struct
+{
+   /** producer index */
+   uint32      *producer;
+   /** consumer index */
+   uint32      *consumer;
+   /** ring flags, XDP_RING_NEED_WAKEUP */
+   uint32      *flags;
+   /** descriptor array */
+   void        *desc;
+   /** number of descriptors - 1 */
+   uint32      mask;
+   /** mapped area */
+   void        *map;
+   /** length of mapped area */
+   size_t      maplen;
+} ec_xskringt;
+
+/** AF_XDP socket with its UMEM and XDP redirect program */
+typedef struct
+{
+   /** UMEM area, rx frames followed by tx frames, NULL if not in use */
+   uint8       *umem;
+   /** length of UMEM area */
+   size_t      umemlen;
+   /** XDP socket */
+   int         fd;
+   /** XSKMAP the XDP program redirects to */
+   int         mapfd;
+   /** XDP program filtering on ETH_P_ECAT */
+   int         progfd;
+   /** link attaching program to interface */
+   int         linkfd;
+   /** TRUE if bound in zero-copy mode */
+   int         zerocopy;
+   ec_xskringt rx;
+   ec_xskringt tx;
+   ec_xskringt fill;
+   ec_xskringt comp;
+   /** UMEM addresses of unused tx frames */
+   uint64      txfree[EC_XDPFRAMES];
+   /** number of unused tx frames */
+   int         ntxfree;
+} ec_xskt;
+
+/** number of frame slots in each capture ring, power of 2 */
+#define EC_CAPSLOTS 256
+
+/** Capture rings, one per direction so each has a single producer */
+enum
+{
+   /** Transmitted frames, produced with tx_mutex held */
+   ECT_CAP_TX,
+   /** Received frames, produced by the thread reading the socket */
+   ECT_CAP_RX
+};
+
+/** One captured frame */
+typedef struct
+{
+   /** capture time in ns since the epoch */
+   int64       time;
+   /** frame length including ethernet header */
+   int         length;
+   /** 0=primary 1=secondary stack */
+   uint8       stacknumber;
+   /** frame index from EtherCAT header */
+   uint8       idx;
+   /** frame data */
+   ec_bufT     data;
+} ec_capslott;
+
+/** Single producer single consumer ring of captured frames */
+typedef struct
+{
+   /** next slot to fill, only written by the producer */
+   uint32      head;
+   /** next slot to write to file, only written by the consumer */
+   uint32      tail;
+   /** frames lost because the ring was full */
+   uint32      dropped;
+   ec_capslott slot[EC_CAPSLOTS];
+} ec_capringt;
+
+/** Frame capture to a pcapng file by a background thread */
+typedef struct
+{
+   /** TRUE while capturing */
+   int         active;
+   /** capture rings, ECT_CAP_TX and ECT_CAP_RX */
+   ec_capringt ring[2];
+   /** pcapng file, FILE pointer */
+   void        *file;
+   /** writer thread */
+   pthread_t   thread;
+} ec_capturet;
 
 /** pointer structure to Tx and Rx stacks */
 typedef struct
 {
    /** socket connection used */
    int         *sock;
+   /** packet ring of socket */
+   ec_ringt    *ring;
+   /** AF_XDP socket */
+   ec_xskt     *xsk;
+   /** number of frame indexes */
+   int         *maxbuf;
    /** tx buffer */
-   ec_bufT     (*txbuf)[EC_MAXBUF];
+   ec_bufT     *txbuf;
    /** tx buffer lengths */
-   int         (*txbuflength)[EC_MAXBUF];
+   int         *txbuflength;
    /** temporary receive buffer */
    ec_bufT     *tempbuf;
    /** rx buffers */
-   ec_bufT     (*rxbuf)[EC_MAXBUF];
+   uint8       **rxbuf;
    /** rx buffer status fields */
-   int         (*rxbufstat)[EC_MAXBUF];
+   int         *rxbufstat;
    /** received MAC source address (middle word) */
-   int         (*rxsa)[EC_MAXBUF];
+   int         *rxsa;
+   /** timestamping mode of socket */
+   int         *tstamp;
+   /** transmit timestamps in ns */
+   int64       *txtime;
+   /** receive timestamps in ns */
+   int64       *rxtime;
 } ec_stackT;
 
 /** pointer structure to buffers for redundant port */
@@ -42,14 +222,31 @@ typedef struct
 {
    ec_stackT   stack;
    int         sockhandle;
-   /** rx buffers */
-   ec_bufT rxbuf[EC_MAXBUF];
+   /** packet ring, used with ECT_PORT_MMAP */
+   ec_ringt    ring;
+   /** AF_XDP socket, used with ECT_PORT_XDP */
+   ec_xskt     xsk;
+   /** memory pool holding the arrays below, allocated by ecx_setupnic() */
+   void *pool;
+   /** rx buffers, point past the ethernet header of a buffer in rxmem,
+    * received frames are swapped in so their data is not copied */
+   uint8 **rxbuf;
    /** rx buffer status */
-   int rxbufstat[EC_MAXBUF];
+   int *rxbufstat;
    /** rx MAC source address */
-   int rxsa[EC_MAXBUF];
+   int *rxsa;
+   /** timestamping mode, ECT_TSTAMP_NONE, ECT_TSTAMP_SOFTWARE or ECT_TSTAMP_HARDWARE */
+   int tstamp;
+   /** NIC timestamping config to put back on close */
+   ec_hwtstampt hwtstamp;
+   /** tx timestamp in ns of the frame sent with this index, 0 if none */
+   int64 *txtime;
+   /** rx timestamp in ns of the frame received with this index, 0 if none */
+   int64 *rxtime;
    /** temporary rx buffer */
    ec_bufT tempinbuf;
+   /** storage of rx buffers */
+   ec_bufT *rxmem;
 } ecx_redportt;
 
 /** pointer structure to buffers, vars and mutexes for port instantiation */
@@ -57,24 +254,78 @@ typedef struct
 {
    ec_stackT   stack;
    int         sockhandle;
-   /** rx buffers */
-   ec_bufT rxbuf[EC_MAXBUF];
+   /** socket backend, ECT_PORT_SOCKET, ECT_PORT_MMAP or ECT_PORT_XDP */
+   int         backend;
+   /** packet ring, used with ECT_PORT_MMAP */
+   ec_ringt    ring;
+   /** AF_XDP socket, used with ECT_PORT_XDP */
+   ec_xskt     xsk;
+   /** set before ecx_setupnic() to enable packet timestamping */
+   int         timestamping;
+   /** receive wait mode, ECT_RXWAIT_SPIN or ECT_RXWAIT_POLL */
+   int         rxwait;
+   /** set before ecx_setupnic() to SO_BUSY_POLL time in us, 0 is off */
+   int         busypoll;
+   /** TRUE to receive and allocate indexes lock-free instead of through
+    * rx_mutex and getindex_mutex, change only while no frames are in flight */
+   int         dispatch;
+   /** TRUE while a thread reads the socket in dispatcher mode */
+   int         rxowner;
+   /** bumped when rxowner is given up while threads sleep on it */
+   int         rxseq;
+   /** number of threads sleeping on rxseq */
+   int         rxsleepers;
+   /** set before ecx_setupnic() to the number of frame indexes, up to
+    * EC_MAXBUFPOOL - 1, 0 is EC_MAXBUF. Frames of all segments of a large group
+    * can then be in flight at the same time. */
+   int         maxbuf;
+   /** memory pool holding the per index arrays below, allocated by ecx_setupnic() */
+   void *pool;
+   /** rx buffers, point past the ethernet header of a buffer in rxmem,
+    * received frames are swapped in so their data is not copied */
+   uint8 **rxbuf;
    /** rx buffer status */
-   int rxbufstat[EC_MAXBUF];
+   int *rxbufstat;
    /** rx MAC source address */
-   int rxsa[EC_MAXBUF];
+   int *rxsa;
+   /** timestamping mode, ECT_TSTAMP_NONE, ECT_TSTAMP_SOFTWARE or ECT_TSTAMP_HARDWARE */
+   int tstamp;
+   /** NIC timestamping config to put back on close */
+   ec_hwtstampt hwtstamp;
+   /** tx timestamp in ns of the frame sent with this index, 0 if none */
+   int64 *txtime;
+   /** rx timestamp in ns of the frame received with this index, 0 if none */
+   int64 *rxtime;
+   /** where the datagram data of the frame with this index is copied to
+    * instead of its rx buffer, NULL if not set, see ecx_setrxplace() */
+   uint8 **rxplace;
+   /** length of the datagram data copied to rxplace */
+   int *rxplacelen;
    /** temporary rx buffer */
    ec_bufT tempinbuf;
    /** temporary rx buffer status */
    int tempinbufs;
+   /** buffers for frames received in one ecx_recvpkts() call, shared by
+    * both stacks, a filed frame is exchanged with the rx buffer of its index */
+   uint8 *rxqueue[EC_MAXBUF];
+   /** storage of rx buffers followed by the receive queue buffers */
+   ec_bufT *rxmem;
    /** transmit buffers */
-   ec_bufT txbuf[EC_MAXBUF];
+   ec_bufT *txbuf;
    /** transmit buffer lengths */
-   int txbuflength[EC_MAXBUF];
+   int *txbuflength;
    /** temporary tx buffer */
    ec_bufT txbuf2;
    /** temporary tx buffer length */
    int txbuflength2;
+   /** frame indexes queued with ecx_queueframe_red() */
+   uint8 *txqueue;
+   /** number of queued frames */
+   int txqueued;
+   /** wire round trip in ns of the last frame completed on the primary stack */
+   int64 roundtrip;
+   /** frame capture, allocated by ecx_capture_start() */
+   ec_capturet *capture;
    /** last used frame index */
    uint8 lastidx;
    /** current redundancy state */
@@ -99,8 +350,12 @@ void ec_setbufstat(uint8 idx, int bufstat);
 uint8 ec_getindex(void);
 int ec_outframe(uint8 idx, int sock);
 int ec_outframe_red(uint8 idx);
+int ec_queueframe_red(uint8 idx);
+int ec_flushframes(void);
 int ec_waitinframe(uint8 idx, int timeout);
 int ec_srconfirm(uint8 idx,int timeout);
+int ec_capture_start(const char *filename);
+void ec_capture_stop(void);
 #endif
 
 void ec_setupheader(void *p);
@@ -110,8 +365,13 @@ void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
 uint8 ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_queueframe_red(ecx_portt *port, uint8 idx);
+int ecx_flushframes(ecx_portt *port);
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
+int ecx_capture_start(ecx_portt *port, const char *filename);
+void ecx_capture_stop(ecx_portt *port);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,257 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * In-process frame capture to pcapng for the RAW socket driver.
+ *
+ * The driver copies every transmitted and received frame into a slot of a
+ * single producer single consumer ring, which is all the cycle thread pays.
+ * A full ring drops the frame and counts it, it never blocks the producer.
+ * Transmitted and received frames use separate rings because they are
+ * produced under different locks. A background thread merges both rings in
+ * time order and writes them as Enhanced Packet Blocks, on interface 0 for
+ * the primary and interface 1 for the secondary stack, with the direction in
+ * the packet flags and the frame index as packet comment.
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oshw.h"
+#include "osal.h"
+#include "nicdrv_pcap.h"
+
+/** writer thread sleep in us when the rings are empty */
+#define EC_CAPIDLE       1000
+/** pcapng block types */
+#define EC_PCAPNG_SHB    0x0A0D0D0A
+#define EC_PCAPNG_IDB    0x00000001
+#define EC_PCAPNG_EPB    0x00000006
+/** pcapng option codes */
+#define EC_PCAPNG_COMMENT 1
+#define EC_PCAPNG_IFNAME  2
+#define EC_PCAPNG_TSRESOL 9
+#define EC_PCAPNG_FLAGS   2
+/** pcapng link type ethernet */
+#define EC_PCAPNG_ETHERNET 1
+
+static void ecx_pcap_put32(FILE *f, uint32 v)
+{
+   fwrite(&v, sizeof(v), 1, f);
+}
+
+static void ecx_pcap_put16(FILE *f, uint16 v)
+{
+   fwrite(&v, sizeof(v), 1, f);
+}
+
+/** Write one pcapng option, value padded to 32 bits */
+static void ecx_pcap_option(FILE *f, uint16 code, const void *val, uint16 len)
+{
+   static const uint8 pad[4] = { 0, 0, 0, 0 };
+
+   ecx_pcap_put16(f, code);
+   ecx_pcap_put16(f, len);
+   fwrite(val, 1, len, f);
+   fwrite(pad, 1, (4 - (len & 3)) & 3, f);
+}
+
+/** Write an Interface Description Block with nanosecond timestamps */
+static void ecx_pcap_idb(FILE *f, const char *name)
+{
+   uint8 tsresol = 9;
+   uint16 namelen = (uint16)strlen(name);
+   uint32 len;
+
+   len = 20 + 4 + ((namelen + 3) & ~3) + 8 + 4;
+   ecx_pcap_put32(f, EC_PCAPNG_IDB);
+   ecx_pcap_put32(f, len);
+   ecx_pcap_put16(f, EC_PCAPNG_ETHERNET);
+   ecx_pcap_put16(f, 0);
+   ecx_pcap_put32(f, EC_BUFSIZE);
+   ecx_pcap_option(f, EC_PCAPNG_IFNAME, name, namelen);
+   ecx_pcap_option(f, EC_PCAPNG_TSRESOL, &tsresol, sizeof(tsresol));
+   ecx_pcap_put32(f, 0);
+   ecx_pcap_put32(f, len);
+}
+
+/** Write captured frame as Enhanced Packet Block */
+static void ecx_pcap_epb(FILE *f, const ec_capslott *slot, int dir)
+{
+   static const uint8 pad[4] = { 0, 0, 0, 0 };
+   char comment[12];
+   uint16 clen;
+   uint32 len, flags;
+
+   clen = (uint16)snprintf(comment, sizeof(comment), "idx %u", slot->idx);
+   /* inbound 1, outbound 2 */
+   flags = (dir == ECT_CAP_RX) ? 1 : 2;
+   len = 28 + ((slot->length + 3) & ~3) + 4 + ((clen + 3) & ~3) + 8 + 4 + 4;
+   ecx_pcap_put32(f, EC_PCAPNG_EPB);
+   ecx_pcap_put32(f, len);
+   ecx_pcap_put32(f, slot->stacknumber);
+   ecx_pcap_put32(f, (uint32)((uint64)slot->time >> 32));
+   ecx_pcap_put32(f, (uint32)slot->time);
+   ecx_pcap_put32(f, slot->length);
+   ecx_pcap_put32(f, slot->length);
+   fwrite(slot->data, 1, slot->length, f);
+   fwrite(pad, 1, (4 - (slot->length & 3)) & 3, f);
+   ecx_pcap_option(f, EC_PCAPNG_COMMENT, comment, clen);
+   ecx_pcap_option(f, EC_PCAPNG_FLAGS, &flags, sizeof(flags));
+   ecx_pcap_put32(f, 0);
+   ecx_pcap_put32(f, len);
+}
+
+/** Oldest frame not yet written from a ring, NULL if ring is empty */
+static ec_capslott *ecx_pcap_peek(ec_capringt *ring)
+{
+   if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+   {
+      return NULL;
+   }
+   return &ring->slot[ring->tail & (EC_CAPSLOTS - 1)];
+}
+
+/** Writer thread, drains both rings in time order until capture stops */
+static void *ecx_pcap_writer(void *arg)
+{
+   ec_capturet *cap = arg;
+   ec_capslott *tx, *rx;
+   int dir, idle;
+
+   idle = 0;
+   for (;;)
+   {
+      tx = ecx_pcap_peek(&cap->ring[ECT_CAP_TX]);
+      rx = ecx_pcap_peek(&cap->ring[ECT_CAP_RX]);
+      if (!tx && !rx)
+      {
+         if (!__atomic_load_n(&cap->active, __ATOMIC_ACQUIRE))
+         {
+            break;
+         }
+         if (!idle++)
+         {
+            fflush(cap->file);
+         }
+         osal_usleep(EC_CAPIDLE);
+         continue;
+      }
+      idle = 0;
+      dir = (!rx || (tx && (tx->time <= rx->time))) ? ECT_CAP_TX : ECT_CAP_RX;
+      ecx_pcap_epb(cap->file, (dir == ECT_CAP_TX) ? tx : rx, dir);
+      /* slot is free for the producer again */
+      __atomic_store_n(&cap->ring[dir].tail, cap->ring[dir].tail + 1, __ATOMIC_RELEASE);
+   }
+   fflush(cap->file);
+
+   return NULL;
+}
+
+/** Start capture to a new pcapng file.
+ * @param[in] cap         = capture state, allocated by caller
+ * @param[in] filename    = pcapng file to create
+ * @return >0 if succeeded
+ */
+int ecx_pcap_open(ec_capturet *cap, const char *filename)
+{
+   FILE *f;
+   int i;
+
+   f = fopen(filename, "wb");
+   if (!f)
+   {
+      return 0;
+   }
+   /* Section Header Block, byte order magic, version 1.0, unknown length */
+   ecx_pcap_put32(f, EC_PCAPNG_SHB);
+   ecx_pcap_put32(f, 28);
+   ecx_pcap_put32(f, 0x1A2B3C4D);
+   ecx_pcap_put16(f, 1);
+   ecx_pcap_put16(f, 0);
+   ecx_pcap_put32(f, 0xffffffff);
+   ecx_pcap_put32(f, 0xffffffff);
+   ecx_pcap_put32(f, 28);
+   ecx_pcap_idb(f, "primary");
+   ecx_pcap_idb(f, "secondary");
+   cap->file = f;
+   /* discard what was left from a previous capture, head stays with the producer */
+   for (i = 0; i < 2; i++)
+   {
+      cap->ring[i].tail = __atomic_load_n(&cap->ring[i].head, __ATOMIC_ACQUIRE);
+      cap->ring[i].dropped = 0;
+   }
+   __atomic_store_n(&cap->active, TRUE, __ATOMIC_RELEASE);
+   if (pthread_create(&cap->thread, NULL, ecx_pcap_writer, cap) != 0)
+   {
+      cap->active = FALSE;
+      fclose(f);
+      cap->file = NULL;
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Stop capture, write the frames still in the rings and close the file.
+ * @param[in] cap         = capture state
+ */
+void ecx_pcap_close(ec_capturet *cap)
+{
+   if (cap->file)
+   {
+      __atomic_store_n(&cap->active, FALSE, __ATOMIC_RELEASE);
+      pthread_join(cap->thread, NULL);
+      fclose(cap->file);
+      cap->file = NULL;
+   }
+}
+
+/** Copy a frame into the capture ring. Called by the single producer of the
+ * ring, never blocks; if the ring is full the frame is dropped.
+ * @param[in] cap         = capture state
+ * @param[in] dir         = ECT_CAP_TX or ECT_CAP_RX
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[in] frame       = frame including ethernet header
+ * @param[in] length      = frame length
+ * @param[in] time        = frame timestamp in ns since the epoch, 0 to take
+ *                          the current time
+ */
+void ecx_pcap_push(ec_capturet *cap, int dir, int stacknumber, const void *frame, int length, int64 time)
+{
+   ec_capringt *ring = &cap->ring[dir];
+   ec_capslott *slot;
+   struct timespec ts;
+   uint32 head;
+
+   head = ring->head;
+   if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= EC_CAPSLOTS)
+   {
+      ring->dropped++;
+      return;
+   }
+   if (!time)
+   {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      time = (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+   }
+   if (length > EC_BUFSIZE)
+   {
+      length = EC_BUFSIZE;
+   }
+   slot = &ring->slot[head & (EC_CAPSLOTS - 1)];
+   slot->time = time;
+   slot->length = length;
+   slot->stacknumber = (uint8)stacknumber;
+   slot->idx = (length > (int)(ETH_HEADERSIZE + offsetof(ec_comt, index))) ?
+               ((const uint8 *)frame)[ETH_HEADERSIZE + offsetof(ec_comt, index)] : 0;
+   memcpy(slot->data, frame, length);
+   /* publish slot to the writer */
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,27 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for nicdrv_pcap.c
+ */
+
+#ifndef _nicdrv_pcaph_
+#define _nicdrv_pcaph_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int ecx_pcap_open(ec_capturet *cap, const char *filename);
+void ecx_pcap_close(ec_capturet *cap);
+void ecx_pcap_push(ec_capturet *cap, int dir, int stacknumber, const void *frame, int length, int64 time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,388 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * EtherCAT AF_XDP socket backend for the RAW socket driver.
+ *
+ * An XDP program on the interface redirects all ETH_P_ECAT frames received
+ * on queue 0 to an AF_XDP socket, other traffic passes on to the kernel
+ * stack as usual. On interfaces with more than one rx queue the NIC must be
+ * configured so EtherCAT frames land on queue 0, f.e. with
+ * "ethtool -L eth0 combined 1".
+ *
+ * Frames live in a UMEM area shared with the kernel. The first EC_XDPFRAMES
+ * frames are handed to the kernel for reception through the fill ring, the
+ * other EC_XDPFRAMES are used for transmission and return via the completion
+ * ring. When the driver supports zero-copy the NIC DMAs directly to and from
+ * the UMEM, otherwise the socket is bound in copy mode (f.e. on veth pairs).
+ *
+ * The UMEM frames can not be the ec_bufT tx and rx buffers themselves; these
+ * are embedded in ecx_portt and are neither page aligned nor sized to a power
+ * of two as UMEM chunks must be. A frame is therefore copied once between UMEM
+ * and the port buffers in user space, instead of once in the kernel and once
+ * more out of the rx queue buffers.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#include "oshw.h"
+#include "osal.h"
+#include "nicdrv_xdp.h"
+
+/** size of one UMEM frame */
+#define EC_XDPFRAMESIZE 2048
+/** number of entries in XSKMAP, covers the rx queue index */
+#define EC_XDPMAPSIZE   64
+
+static int ecx_bpf(int cmd, union bpf_attr *attr)
+{
+   return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/** Map one AF_XDP ring into user space.
+ * @param[in] fd          = XDP socket
+ * @param[out] r          = ring
+ * @param[in] off         = ring offsets from XDP_MMAP_OFFSETS
+ * @param[in] descsize    = size of one descriptor
+ * @param[in] pgoff       = mmap offset selecting the ring
+ * @return >0 if succeeded
+ */
+static int ecx_xdp_mapring(int fd, ec_xskringt *r, const struct xdp_ring_offset *off,
+                           size_t descsize, off_t pgoff)
+{
+   r->maplen = off->desc + EC_XDPFRAMES * descsize;
+   r->map = mmap(NULL, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+   if (r->map == MAP_FAILED)
+   {
+      r->map = NULL;
+      return 0;
+   }
+   r->producer = (uint32 *)((uint8 *)r->map + off->producer);
+   r->consumer = (uint32 *)((uint8 *)r->map + off->consumer);
+   r->flags = (uint32 *)((uint8 *)r->map + off->flags);
+   r->desc = (uint8 *)r->map + off->desc;
+   r->mask = EC_XDPFRAMES - 1;
+
+   return 1;
+}
+
+/** Load XDP program that redirects ETH_P_ECAT frames to the XSKMAP.
+ * @param[in] mapfd       = XSKMAP
+ * @return program fd, <0 on failure
+ */
+static int ecx_xdp_loadprog(int mapfd)
+{
+   struct bpf_insn prog[16];
+   union bpf_attr attr;
+   int n = 0;
+
+   memset(prog, 0, sizeof(prog));
+   /* r6 = ctx */
+   prog[n].code = BPF_ALU64 | BPF_MOV | BPF_X; prog[n].dst_reg = 6; prog[n].src_reg = 1; n++;
+   /* r2 = ctx->data, r3 = ctx->data_end */
+   prog[n].code = BPF_LDX | BPF_MEM | BPF_W; prog[n].dst_reg = 2; prog[n].src_reg = 6;
+   prog[n].off = offsetof(struct xdp_md, data); n++;
+   prog[n].code = BPF_LDX | BPF_MEM | BPF_W; prog[n].dst_reg = 3; prog[n].src_reg = 6;
+   prog[n].off = offsetof(struct xdp_md, data_end); n++;
+   /* if (data + ETH_HEADERSIZE > data_end) goto pass */
+   prog[n].code = BPF_ALU64 | BPF_MOV | BPF_X; prog[n].dst_reg = 4; prog[n].src_reg = 2; n++;
+   prog[n].code = BPF_ALU64 | BPF_ADD | BPF_K; prog[n].dst_reg = 4; prog[n].imm = ETH_HEADERSIZE; n++;
+   prog[n].code = BPF_JMP | BPF_JGT | BPF_X; prog[n].dst_reg = 4; prog[n].src_reg = 3; prog[n].off = 8; n++;
+   /* if (ethertype != ETH_P_ECAT) goto pass */
+   prog[n].code = BPF_LDX | BPF_MEM | BPF_H; prog[n].dst_reg = 4; prog[n].src_reg = 2;
+   prog[n].off = offsetof(ec_etherheadert, etype); n++;
+   prog[n].code = BPF_JMP | BPF_JNE | BPF_K; prog[n].dst_reg = 4; prog[n].off = 6;
+   prog[n].imm = htons(ETH_P_ECAT); n++;
+   /* return bpf_redirect_map(mapfd, ctx->rx_queue_index, XDP_PASS) */
+   prog[n].code = BPF_LDX | BPF_MEM | BPF_W; prog[n].dst_reg = 2; prog[n].src_reg = 6;
+   prog[n].off = offsetof(struct xdp_md, rx_queue_index); n++;
+   prog[n].code = BPF_LD | BPF_DW | BPF_IMM; prog[n].dst_reg = 1; prog[n].src_reg = BPF_PSEUDO_MAP_FD;
+   prog[n].imm = mapfd; n++;
+   n++;
+   prog[n].code = BPF_ALU64 | BPF_MOV | BPF_K; prog[n].dst_reg = 3; prog[n].imm = XDP_PASS; n++;
+   prog[n].code = BPF_JMP | BPF_CALL; prog[n].imm = BPF_FUNC_redirect_map; n++;
+   prog[n].code = BPF_JMP | BPF_EXIT; n++;
+   /* pass: return XDP_PASS */
+   prog[n].code = BPF_ALU64 | BPF_MOV | BPF_K; prog[n].dst_reg = 0; prog[n].imm = XDP_PASS; n++;
+   prog[n].code = BPF_JMP | BPF_EXIT; n++;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.prog_type = BPF_PROG_TYPE_XDP;
+   attr.insns = (uint64)(uintptr_t)prog;
+   attr.insn_cnt = n;
+   attr.license = (uint64)(uintptr_t)"GPL";
+
+   return ecx_bpf(BPF_PROG_LOAD, &attr);
+}
+
+/** Setup AF_XDP socket, UMEM and XDP redirect program on interface.
+ * Zero-copy mode is tried first, then copy mode.
+ * @param[out] xsk        = AF_XDP socket state
+ * @param[in] ifindex     = interface index
+ * @return >0 if succeeded, on failure everything is released again
+ */
+int ecx_xdp_setup(ec_xskt *xsk, int ifindex)
+{
+   struct xdp_umem_reg reg;
+   struct xdp_mmap_offsets off;
+   struct sockaddr_xdp sxdp;
+   union bpf_attr attr;
+   socklen_t optlen;
+   uint32 key;
+   int i, n;
+
+   memset(xsk, 0, sizeof(*xsk));
+   xsk->mapfd = -1;
+   xsk->progfd = -1;
+   xsk->linkfd = -1;
+   xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+   if (xsk->fd < 0)
+      return 0;
+   xsk->umemlen = 2 * EC_XDPFRAMES * EC_XDPFRAMESIZE;
+   xsk->umem = mmap(NULL, xsk->umemlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (xsk->umem == MAP_FAILED)
+   {
+      xsk->umem = NULL;
+      goto fail;
+   }
+   memset(&reg, 0, sizeof(reg));
+   reg.addr = (uint64)(uintptr_t)xsk->umem;
+   reg.len = xsk->umemlen;
+   reg.chunk_size = EC_XDPFRAMESIZE;
+   n = EC_XDPFRAMES;
+   if ((setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) ||
+       (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) < 0) ||
+       (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) < 0) ||
+       (setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &n, sizeof(n)) < 0) ||
+       (setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &n, sizeof(n)) < 0))
+      goto fail;
+   optlen = sizeof(off);
+   if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+      goto fail;
+   if (!ecx_xdp_mapring(xsk->fd, &xsk->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+       !ecx_xdp_mapring(xsk->fd, &xsk->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) ||
+       !ecx_xdp_mapring(xsk->fd, &xsk->fill, &off.fr, sizeof(uint64), XDP_UMEM_PGOFF_FILL_RING) ||
+       !ecx_xdp_mapring(xsk->fd, &xsk->comp, &off.cr, sizeof(uint64), XDP_UMEM_PGOFF_COMPLETION_RING))
+      goto fail;
+   /* give all rx frames to the kernel, keep the tx frames */
+   for (i = 0; i < EC_XDPFRAMES; i++)
+   {
+      ((uint64 *)xsk->fill.desc)[i] = (uint64)i * EC_XDPFRAMESIZE;
+      xsk->txfree[i] = (uint64)(EC_XDPFRAMES + i) * EC_XDPFRAMESIZE;
+   }
+   __atomic_store_n(xsk->fill.producer, EC_XDPFRAMES, __ATOMIC_RELEASE);
+   xsk->ntxfree = EC_XDPFRAMES;
+
+   memset(&sxdp, 0, sizeof(sxdp));
+   sxdp.sxdp_family = AF_XDP;
+   sxdp.sxdp_ifindex = ifindex;
+   sxdp.sxdp_queue_id = 0;
+   sxdp.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+   xsk->zerocopy = TRUE;
+   if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0)
+   {
+      /* no zero-copy support in driver */
+      sxdp.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+      xsk->zerocopy = FALSE;
+      if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0)
+         goto fail;
+   }
+
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = BPF_MAP_TYPE_XSKMAP;
+   attr.key_size = sizeof(uint32);
+   attr.value_size = sizeof(int);
+   attr.max_entries = EC_XDPMAPSIZE;
+   xsk->mapfd = ecx_bpf(BPF_MAP_CREATE, &attr);
+   if (xsk->mapfd < 0)
+      goto fail;
+   key = sxdp.sxdp_queue_id;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = xsk->mapfd;
+   attr.key = (uint64)(uintptr_t)&key;
+   attr.value = (uint64)(uintptr_t)&xsk->fd;
+   if (ecx_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+      goto fail;
+   xsk->progfd = ecx_xdp_loadprog(xsk->mapfd);
+   if (xsk->progfd < 0)
+      goto fail;
+   /* attach in native driver mode, else generic mode */
+   memset(&attr, 0, sizeof(attr));
+   attr.link_create.prog_fd = xsk->progfd;
+   attr.link_create.target_ifindex = ifindex;
+   attr.link_create.attach_type = BPF_XDP;
+   attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+   xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   if (xsk->linkfd < 0)
+   {
+      attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+      xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   }
+   if (xsk->linkfd < 0)
+      goto fail;
+
+   return 1;
+
+fail:
+   ecx_xdp_close(xsk);
+   return 0;
+}
+
+/** Detach XDP program and release AF_XDP socket and UMEM.
+ * @param[in] xsk         = AF_XDP socket state
+ */
+void ecx_xdp_close(ec_xskt *xsk)
+{
+   ec_xskringt *r[4];
+   int i;
+
+   /* closing the link detaches the program */
+   if (xsk->linkfd >= 0)
+      close(xsk->linkfd);
+   if (xsk->progfd >= 0)
+      close(xsk->progfd);
+   if (xsk->mapfd >= 0)
+      close(xsk->mapfd);
+   r[0] = &xsk->rx;
+   r[1] = &xsk->tx;
+   r[2] = &xsk->fill;
+   r[3] = &xsk->comp;
+   for (i = 0; i < 4; i++)
+   {
+      if (r[i]->map)
+         munmap(r[i]->map, r[i]->maplen);
+      r[i]->map = NULL;
+   }
+   if (xsk->fd >= 0)
+      close(xsk->fd);
+   if (xsk->umem)
+      munmap(xsk->umem, xsk->umemlen);
+   xsk->umem = NULL;
+   xsk->fd = -1;
+   xsk->mapfd = -1;
+   xsk->progfd = -1;
+   xsk->linkfd = -1;
+}
+
+/** Queue frame on AF_XDP tx ring, ecx_xdp_kick() has the kernel transmit it.
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[in] buf         = frame to transmit
+ * @param[in] len         = length of frame
+ * @return len if queued, -1 if no tx frame available
+ */
+int ecx_xdp_put(ec_xskt *xsk, const void *buf, int len)
+{
+   struct xdp_desc *desc;
+   uint32 cons, prod;
+   uint64 addr;
+
+   /* reclaim transmitted frames */
+   cons = *xsk->comp.consumer;
+   prod = __atomic_load_n(xsk->comp.producer, __ATOMIC_ACQUIRE);
+   while (cons != prod)
+   {
+      xsk->txfree[xsk->ntxfree++] = ((uint64 *)xsk->comp.desc)[cons & xsk->comp.mask];
+      cons++;
+   }
+   __atomic_store_n(xsk->comp.consumer, cons, __ATOMIC_RELEASE);
+   if ((xsk->ntxfree == 0) || (len > EC_XDPFRAMESIZE))
+   {
+      return -1;
+   }
+   addr = xsk->txfree[--xsk->ntxfree];
+   memcpy(xsk->umem + addr, buf, len);
+   prod = *xsk->tx.producer;
+   desc = (struct xdp_desc *)xsk->tx.desc + (prod & xsk->tx.mask);
+   desc->addr = addr;
+   desc->len = len;
+   desc->options = 0;
+   __atomic_store_n(xsk->tx.producer, prod + 1, __ATOMIC_RELEASE);
+
+   return len;
+}
+
+/** Wake up the kernel to transmit queued frames if needed.
+ * @param[in] xsk         = AF_XDP socket state
+ * @return <0 on error
+ */
+int ecx_xdp_kick(ec_xskt *xsk)
+{
+   uint32 cons;
+
+   /* copy mode always transmits from within sendto(), but only a limited
+    * batch of frames per call, repeat while that makes progress */
+   if (!xsk->zerocopy || (__atomic_load_n(xsk->tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP))
+   {
+      do
+      {
+         cons = __atomic_load_n(xsk->tx.consumer, __ATOMIC_ACQUIRE);
+         if ((sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0) &&
+             (errno != EAGAIN) && (errno != EBUSY) && (errno != ENOBUFS))
+         {
+            return -1;
+         }
+      } while (!xsk->zerocopy &&
+               (__atomic_load_n(xsk->tx.consumer, __ATOMIC_ACQUIRE) != cons) &&
+               (__atomic_load_n(xsk->tx.consumer, __ATOMIC_ACQUIRE) != *xsk->tx.producer));
+   }
+
+   return 0;
+}
+
+/** Look at next frame in AF_XDP rx ring. The UMEM frame stays with the
+ * caller until ecx_xdp_release().
+ * @param[in] xsk         = AF_XDP socket state
+ * @param[out] frame      = frame in UMEM
+ * @return number of bytes received, 0 if no frame available
+ */
+int ecx_xdp_peek(ec_xskt *xsk, const uint8 **frame)
+{
+   struct xdp_desc *desc;
+   uint32 cons, prod;
+
+   cons = *xsk->rx.consumer;
+   prod = __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE);
+   if (cons == prod)
+   {
+      if (__atomic_load_n(xsk->fill.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)
+      {
+         recvfrom(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+      }
+      return 0;
+   }
+   desc = (struct xdp_desc *)xsk->rx.desc + (cons & xsk->rx.mask);
+   *frame = xsk->umem + desc->addr;
+
+   return desc->len;
+}
+
+/** Give the UMEM frame taken with ecx_xdp_peek() back to the kernel.
+ * @param[in] xsk         = AF_XDP socket state
+ */
+void ecx_xdp_release(ec_xskt *xsk)
+{
+   struct xdp_desc *desc;
+   uint32 cons, fprod;
+
+   cons = *xsk->rx.consumer;
+   desc = (struct xdp_desc *)xsk->rx.desc + (cons & xsk->rx.mask);
+   /* refill, rx frames never outnumber the fill ring */
+   fprod = *xsk->fill.producer;
+   ((uint64 *)xsk->fill.desc)[fprod & xsk->fill.mask] = desc->addr & ~((uint64)EC_XDPFRAMESIZE - 1);
+   __atomic_store_n(xsk->fill.producer, fprod + 1, __ATOMIC_RELEASE);
+   __atomic_store_n(xsk->rx.consumer, cons + 1, __ATOMIC_RELEASE);
+}
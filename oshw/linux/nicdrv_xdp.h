@@ -0,0 +1,30 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for nicdrv_xdp.c
+ */
+
+#ifndef _nicdrv_xdph_
+#define _nicdrv_xdph_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int ecx_xdp_setup(ec_xskt *xsk, int ifindex);
+void ecx_xdp_close(ec_xskt *xsk);
+int ecx_xdp_put(ec_xskt *xsk, const void *buf, int len);
+int ecx_xdp_kick(ec_xskt *xsk);
+int ecx_xdp_peek(ec_xskt *xsk, const uint8 **frame);
+void ecx_xdp_release(ec_xskt *xsk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,565 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * EtherCAT simulated segment driver.
+ *
+ * Drop-in replacement for the NIC drivers that does not touch the network.
+ * Frames are passed through an in-memory chain of simulated EtherCAT slave
+ * controllers (see simesc.c) at transmit time and are immediately available
+ * in the indexed receive buffers. This makes the master stack run against
+ * hundreds of slaves on any host, with deterministic timing, which is useful
+ * to benchmark configuration and process data handling without hardware.
+ *
+ * The segment is either described by the interface name
+ * "sim[:slaves[:outputbits[:inputbits[:coe]]]]", for example "sim:200:16:16",
+ * or built slave by slave with ecx_sim_addslave() before ecx_setupnic().
+ *
+ * In redundant mode the ring is closed: frames sent on the primary port pass
+ * all slaves and are received on the secondary port, frames sent on the
+ * secondary port pass unprocessed and are received on the primary port.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "ethercattype.h"
+#include "nicdrv.h"
+#include "simesc.h"
+#include "osal.h"
+
+/** Redundancy modes */
+enum
+{
+   /** No redundancy, single NIC mode */
+   ECT_RED_NONE,
+   /** Double redundant NIC connection */
+   ECT_RED_DOUBLE
+};
+
+/** Primary source MAC address used for EtherCAT.
+ * This address is not the MAC address used from the NIC.
+ * EtherCAT does not care about MAC addressing, but it is used here to
+ * differentiate the route the packet traverses through the EtherCAT
+ * segment. This is needed to find out the packet flow in redundant
+ * configurations. */
+const uint16 priMAC[3] = { 0x0101, 0x0101, 0x0101 };
+/** Secondary source MAC address used for EtherCAT. */
+const uint16 secMAC[3] = { 0x0404, 0x0404, 0x0404 };
+
+/** second MAC word is used for identification */
+#define RX_PRIM priMAC[1]
+/** second MAC word is used for identification */
+#define RX_SEC secMAC[1]
+
+static void ecx_clear_rxbufstat(int *rxbufstat)
+{
+   int i;
+   for(i = 0; i < EC_MAXBUF; i++)
+   {
+      rxbufstat[i] = EC_BUF_EMPTY;
+   }
+}
+
+/** Basic setup of the simulated segment.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = segment description, see file header
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @return >0 if succeeded
+ */
+int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
+{
+   int i;
+
+   if (secondary)
+   {
+      /* secondary port struct available? */
+      if (port->redport)
+      {
+         /* when using secondary socket it is automatically a redundant setup */
+         port->redport->sockhandle        = 1;
+         port->redstate                   = ECT_RED_DOUBLE;
+         port->redport->stack.sock        = &(port->redport->sockhandle);
+         port->redport->stack.txbuf       = &(port->txbuf);
+         port->redport->stack.txbuflength = &(port->txbuflength);
+         port->redport->stack.tempbuf     = &(port->redport->tempinbuf);
+         port->redport->stack.rxbuf       = &(port->redport->rxbuf);
+         port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
+         port->redport->stack.rxsa        = &(port->redport->rxsa);
+         ecx_clear_rxbufstat(&(port->redport->rxbufstat[0]));
+         return 1;
+      }
+      /* fail */
+      return 0;
+   }
+
+   /* slaves added by the application take precedence over the name */
+   if ((port->sim.slavecount == 0) && (ecx_sim_setup(&(port->sim), ifname) == 0))
+   {
+      return 0;
+   }
+   pthread_mutex_init(&(port->getindex_mutex), NULL);
+   pthread_mutex_init(&(port->tx_mutex), NULL);
+   pthread_mutex_init(&(port->rx_mutex), NULL);
+   port->sockhandle        = 1;
+   port->lastidx           = 0;
+   port->redstate          = ECT_RED_NONE;
+   port->stack.sock        = &(port->sockhandle);
+   port->stack.txbuf       = &(port->txbuf);
+   port->stack.txbuflength = &(port->txbuflength);
+   port->stack.tempbuf     = &(port->tempinbuf);
+   port->stack.rxbuf       = &(port->rxbuf);
+   port->stack.rxbufstat   = &(port->rxbufstat);
+   port->stack.rxsa        = &(port->rxsa);
+   ecx_clear_rxbufstat(&(port->rxbufstat[0]));
+   for (i = 0; i < EC_MAXBUF; i++)
+   {
+      ec_setupheader(&(port->txbuf[i]));
+   }
+   ec_setupheader(&(port->txbuf2));
+
+   return 1;
+}
+
+/** Close simulated segment and free all simulated slaves.
+ * @param[in] port        = port context struct
+ * @return 0
+ */
+int ecx_closenic(ecx_portt *port)
+{
+   if (port->sockhandle)
+   {
+      pthread_mutex_destroy(&(port->getindex_mutex));
+      pthread_mutex_destroy(&(port->tx_mutex));
+      pthread_mutex_destroy(&(port->rx_mutex));
+      port->sockhandle = 0;
+   }
+   if (port->redport)
+   {
+      port->redport->sockhandle = 0;
+   }
+   ecx_sim_free(&(port->sim));
+
+   return 0;
+}
+
+/** Fill buffer with ethernet header structure.
+ * Destination MAC is always broadcast.
+ * Ethertype is always ETH_P_ECAT.
+ * @param[out] p = buffer
+ */
+void ec_setupheader(void *p)
+{
+   ec_etherheadert *bp;
+   bp = p;
+   bp->da0 = htons(0xffff);
+   bp->da1 = htons(0xffff);
+   bp->da2 = htons(0xffff);
+   bp->sa0 = htons(priMAC[0]);
+   bp->sa1 = htons(priMAC[1]);
+   bp->sa2 = htons(priMAC[2]);
+   bp->etype = htons(ETH_P_ECAT);
+}
+
+/** Get new frame identifier index and allocate corresponding rx buffer.
+ * @param[in] port        = port context struct
+ * @return new index.
+ */
+uint8 ecx_getindex(ecx_portt *port)
+{
+   uint8 idx;
+   uint8 cnt;
+
+   pthread_mutex_lock(&(port->getindex_mutex));
+   idx = port->lastidx + 1;
+   /* index can't be larger than buffer array */
+   if (idx >= EC_MAXBUF)
+   {
+      idx = 0;
+   }
+   cnt = 0;
+   /* try to find unused index */
+   while ((port->rxbufstat[idx] != EC_BUF_EMPTY) && (cnt < EC_MAXBUF))
+   {
+      idx++;
+      cnt++;
+      if (idx >= EC_MAXBUF)
+      {
+         idx = 0;
+      }
+   }
+   port->rxbufstat[idx] = EC_BUF_ALLOC;
+   if (port->redstate != ECT_RED_NONE)
+      port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+   port->lastidx = idx;
+   pthread_mutex_unlock(&(port->getindex_mutex));
+
+   return idx;
+}
+
+/** Set rx buffer status.
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index in buffer array
+ * @param[in] bufstat   = status to set
+ */
+void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat)
+{
+   port->rxbufstat[idx] = bufstat;
+   if (port->redstate != ECT_RED_NONE)
+      port->redport->rxbufstat[idx] = bufstat;
+}
+
+/** Pass a frame through the segment and put it in the rx buffer of the
+ * stack where it comes out.
+ * @param[in] port        = port context struct
+ * @param[in] frame       = frame to transmit
+ * @param[in] length      = frame length
+ * @param[in] idx         = index in rx buffer array
+ * @param[in] stacknumber = 0=Primary 1=Secondary stack
+ */
+static void ecx_simtransfer(ecx_portt *port, const void *frame, int length, uint8 idx, int stacknumber)
+{
+   ec_stackT *stack;
+   ec_etherheadert *ehp;
+
+   pthread_mutex_lock(&(port->tx_mutex));
+   memcpy(port->tempinbuf, frame, length);
+   if (!stacknumber)
+   {
+      ecx_sim_process(&(port->sim), port->tempinbuf, length);
+   }
+   /* closed ring in redundant mode, frame comes out on the other port */
+   if ((port->redstate != ECT_RED_NONE) == !stacknumber)
+   {
+      stack = &(port->redport->stack);
+   }
+   else
+   {
+      stack = &(port->stack);
+   }
+   ehp = (ec_etherheadert *)port->tempinbuf;
+   memcpy(&(*stack->rxbuf)[idx], &(port->tempinbuf[ETH_HEADERSIZE]), length - ETH_HEADERSIZE);
+   (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+   (*stack->rxbufstat)[idx] = EC_BUF_RCVD;
+   pthread_mutex_unlock(&(port->tx_mutex));
+}
+
+/** Transmit buffer to the simulated segment.
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index in tx buffer array
+ * @param[in] stacknumber   = 0=Primary 1=Secondary stack
+ * @return always 0
+ */
+int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   /* in redundant mode the opposite frame may already be in */
+   if ((*stack->rxbufstat)[idx] != EC_BUF_RCVD)
+   {
+      (*stack->rxbufstat)[idx] = EC_BUF_TX;
+   }
+   ecx_simtransfer(port, (*stack->txbuf)[idx], (*stack->txbuflength)[idx], idx, stacknumber);
+
+   return 0;
+}
+
+/** Transmit buffer to the simulated segment, in redundant mode also a dummy
+ * frame on the secondary port.
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index in tx buffer array
+ * @return always 0
+ */
+int ecx_outframe_red(ecx_portt *port, uint8 idx)
+{
+   ec_comt *datagramP;
+   ec_etherheadert *ehp;
+   int rval;
+
+   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
+   /* rewrite MAC source address 1 to primary */
+   ehp->sa1 = htons(priMAC[1]);
+   /* transmit over primary port */
+   rval = ecx_outframe(port, idx, 0);
+   if (port->redstate != ECT_RED_NONE)
+   {
+      ehp = (ec_etherheadert *)&(port->txbuf2);
+      /* use dummy frame for secondary transmit (BRD) */
+      datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
+      /* write index to frame */
+      datagramP->index = idx;
+      /* rewrite MAC source address 1 to secondary */
+      ehp->sa1 = htons(secMAC[1]);
+      /* transmit over secondary port */
+      if (port->redport->rxbufstat[idx] != EC_BUF_RCVD)
+      {
+         port->redport->rxbufstat[idx] = EC_BUF_TX;
+      }
+      ecx_simtransfer(port, &(port->txbuf2), port->txbuflength2, idx, 1);
+   }
+
+   return rval;
+}
+
+/** Queue buffer for transmission with ecx_flushframes(). The simulated
+ * segment processes frames synchronously, so the frame is sent right away.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @return always 0
+ */
+int ecx_queueframe_red(ecx_portt *port, uint8 idx)
+{
+   return ecx_outframe_red(port, idx);
+}
+
+/** Transmit all frames queued with ecx_queueframe_red().
+ * @param[in] port        = port context struct
+ * @return number of frames sent, always 0 as frames are not queued
+ */
+int ecx_flushframes(ecx_portt *port)
+{
+   (void)port;
+   return 0;
+}
+
+/** Have the data of a received datagram copied straight to its place. This
+ * port has no such receive path, the caller copies it from the rx buffer.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[in] data        = where the datagram data goes
+ * @param[in] length      = length of datagram data
+ * @return FALSE, the data is never placed
+ */
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length)
+{
+   (void)port;
+   (void)idx;
+   (void)data;
+   (void)length;
+   return FALSE;
+}
+
+/** Non blocking receive frame function. Frames are placed in their indexed
+ * rx buffer at transmit time, so this only checks the buffer status.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber  = 0=primary 1=secondary stack
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME.
+ */
+int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   uint16  l;
+   int     rval;
+   ec_stackT *stack;
+   ec_bufT *rxbuf;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   rval = EC_NOFRAME;
+   rxbuf = &(*stack->rxbuf)[idx];
+   pthread_mutex_lock(&(port->rx_mutex));
+   if ((idx < EC_MAXBUF) && ((*stack->rxbufstat)[idx] == EC_BUF_RCVD))
+   {
+      l = (*rxbuf)[0] + ((uint16)((*rxbuf)[1] & 0x0f) << 8);
+      /* return WKC */
+      rval = ((*rxbuf)[l] + ((uint16)(*rxbuf)[l + 1] << 8));
+      /* mark as completed */
+      (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+   }
+   pthread_mutex_unlock(&(port->rx_mutex));
+
+   return rval;
+}
+
+/** Blocking redundant receive frame function. If redundant mode is not active then
+ * it skips the secondary stack and redundancy functions. In redundant mode it waits
+ * for both (primary and secondary) frames to come in.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx = requested index of frame
+ * @param[in] timer = absolute timeout time
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME.
+ */
+static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
+{
+   int wkc  = EC_NOFRAME;
+   int wkc2 = EC_NOFRAME;
+   int primrx, secrx;
+
+   /* if not in redundant mode then always assume secondary is OK */
+   if (port->redstate == ECT_RED_NONE)
+      wkc2 = 0;
+   do
+   {
+      /* only read frame if not already in */
+      if (wkc <= EC_NOFRAME)
+         wkc  = ecx_inframe(port, idx, 0);
+      /* only try secondary if in redundant mode */
+      if (port->redstate != ECT_RED_NONE)
+      {
+         /* only read frame if not already in */
+         if (wkc2 <= EC_NOFRAME)
+            wkc2 = ecx_inframe(port, idx, 1);
+      }
+   /* wait for both frames to arrive or timeout */
+   } while (((wkc <= EC_NOFRAME) || (wkc2 <= EC_NOFRAME)) && !osal_timer_is_expired(timer));
+   /* only do redundant functions when in redundant mode */
+   if (port->redstate != ECT_RED_NONE)
+   {
+      /* primrx if the received MAC source on primary socket */
+      primrx = 0;
+      if (wkc > EC_NOFRAME) primrx = port->rxsa[idx];
+      /* secrx if the received MAC source on psecondary socket */
+      secrx = 0;
+      if (wkc2 > EC_NOFRAME) secrx = port->redport->rxsa[idx];
+
+      /* primary socket got secondary frame and secondary socket got primary frame */
+      /* normal situation in redundant mode, the simulated ring is always closed */
+      if ( ((primrx == RX_SEC) && (secrx == RX_PRIM)) )
+      {
+         /* copy secondary buffer to primary */
+         memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
+         wkc = wkc2;
+      }
+   }
+
+   /* return WKC or EC_NOFRAME */
+   return wkc;
+}
+
+/** Blocking receive frame function. Calls ec_waitinframe_red().
+ * @param[in] port        = port context struct
+ * @param[in] idx       = requested index of frame
+ * @param[in] timeout   = timeout in us
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME.
+ */
+int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
+{
+   int wkc;
+   osal_timert timer;
+
+   osal_timer_start (&timer, timeout);
+   wkc = ecx_waitinframe_red(port, idx, &timer);
+
+   return wkc;
+}
+
+/** Blocking send and receive frame function. Used for non processdata frames.
+ * A datagram is build into a frame and transmitted via this function. It waits
+ * for an answer and returns the workcounter. The function retries if time is
+ * left and the result is WKC=0 or no frame received.
+ *
+ * The function calls ec_outframe_red() and ec_waitinframe_red().
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index of frame
+ * @param[in] timeout  = timeout in us
+ * @return Workcounter or EC_NOFRAME
+ */
+int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
+{
+   int wkc = EC_NOFRAME;
+   osal_timert timer1, timer2;
+
+   osal_timer_start (&timer1, timeout);
+   do
+   {
+      /* tx frame on primary and if in redundant mode a dummy on secondary */
+      ecx_outframe_red(port, idx);
+      if (timeout < EC_TIMEOUTRET)
+      {
+         osal_timer_start (&timer2, timeout);
+      }
+      else
+      {
+         /* normally use partial timeout for rx */
+         osal_timer_start (&timer2, EC_TIMEOUTRET);
+      }
+      /* get frame from primary or if in redundant mode possibly from secondary */
+      wkc = ecx_waitinframe_red(port, idx, &timer2);
+   /* wait for answer with WKC>=0 or otherwise retry until timeout */
+   } while ((wkc <= EC_NOFRAME) && !osal_timer_is_expired (&timer1));
+
+   return wkc;
+}
+
+#ifdef EC_VER1
+
+int ec_setupnic(const char *ifname, int secondary)
+{
+   return ecx_setupnic(&ecx_port, ifname, secondary);
+}
+
+int ec_closenic(void)
+{
+   return ecx_closenic(&ecx_port);
+}
+
+uint8 ec_getindex(void)
+{
+   return ecx_getindex(&ecx_port);
+}
+
+void ec_setbufstat(uint8 idx, int bufstat)
+{
+   ecx_setbufstat(&ecx_port, idx, bufstat);
+}
+
+int ec_outframe(uint8 idx, int stacknumber)
+{
+   return ecx_outframe(&ecx_port, idx, stacknumber);
+}
+
+int ec_outframe_red(uint8 idx)
+{
+   return ecx_outframe_red(&ecx_port, idx);
+}
+
+int ec_queueframe_red(uint8 idx)
+{
+   return ecx_queueframe_red(&ecx_port, idx);
+}
+
+int ec_flushframes(void)
+{
+   return ecx_flushframes(&ecx_port);
+}
+
+int ec_inframe(uint8 idx, int stacknumber)
+{
+   return ecx_inframe(&ecx_port, idx, stacknumber);
+}
+
+int ec_waitinframe(uint8 idx, int timeout)
+{
+   return ecx_waitinframe(&ecx_port, idx, timeout);
+}
+
+int ec_srconfirm(uint8 idx, int timeout)
+{
+   return ecx_srconfirm(&ecx_port, idx, timeout);
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for nicdrv.c
+ */
+
+#ifndef _nicdrvh_
+#define _nicdrvh_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <pthread.h>
+
+/** ESC address space emulated per simulated slave, registers and process RAM */
+#define EC_SIMMEMSIZE      0x4000
+/** number of FMMUs per simulated slave */
+#define EC_SIMFMMU         8
+/** number of SyncManagers per simulated slave */
+#define EC_SIMSM           8
+/** maximum number of PDOs per simulated slave object dictionary */
+#define EC_SIMMAXPDO       16
+/** maximum number of entries per simulated PDO */
+#define EC_SIMMAXPDOENTRY  32
+/** default number of simulated slaves if not given in the interface name */
+#define EC_SIMDEFSLAVES    8
+/** default output and input bits per simulated slave */
+#define EC_SIMDEFBITS      32
+
+/** PDO as seen by the CoE object dictionary of a simulated slave */
+typedef struct
+{
+   /** PDO index, 0x16xx or 0x1Axx */
+   uint16      index;
+   /** SyncManager the PDO is assigned to */
+   uint8       sm;
+   /** number of mapped entries */
+   uint8       nentry;
+   /** mapping entries, index << 16 + subindex << 8 + bitlength */
+   uint32      entry[EC_SIMMAXPDOENTRY];
+} ec_simpdot;
+
+/** One simulated EtherCAT slave controller */
+typedef struct
+{
+   /** ESC register and process RAM image */
+   uint8       *mem;
+   /** SII EEPROM image */
+   uint16      *sii;
+   /** SII EEPROM size in words */
+   int         siiwords;
+   /** number of PDOs in object dictionary */
+   int         npdo;
+   /** object dictionary PDOs, derived from SII PDO categories */
+   ec_simpdot  pdo[EC_SIMMAXPDO];
+} ec_simslavet;
+
+/** Simulated EtherCAT segment, slaves in line topology */
+typedef struct
+{
+   /** number of slaves in segment */
+   int            slavecount;
+   /** allocated slave entries */
+   int            maxslaves;
+   /** slave array, position 0 is the first slave after the master */
+   ec_simslavet   *slave;
+   /** copy output SM data to input SM data on each logical write */
+   int            loopback;
+   /** datagrams processed */
+   uint64         datagrams;
+   /** frames processed */
+   uint64         frames;
+} ec_simsegt;
+
+/** pointer structure to Tx and Rx stacks */
+typedef struct
+{
+   /** socket connection used */
+   int         *sock;
+   /** tx buffer */
+   ec_bufT     (*txbuf)[EC_MAXBUF];
+   /** tx buffer lengths */
+   int         (*txbuflength)[EC_MAXBUF];
+   /** temporary receive buffer */
+   ec_bufT     *tempbuf;
+   /** rx buffers */
+   ec_bufT     (*rxbuf)[EC_MAXBUF];
+   /** rx buffer status fields */
+   int         (*rxbufstat)[EC_MAXBUF];
+   /** received MAC source address (middle word) */
+   int         (*rxsa)[EC_MAXBUF];
+} ec_stackT;
+
+/** pointer structure to buffers for redundant port */
+typedef struct
+{
+   ec_stackT   stack;
+   int         sockhandle;
+   /** rx buffers */
+   ec_bufT rxbuf[EC_MAXBUF];
+   /** rx buffer status */
+   int rxbufstat[EC_MAXBUF];
+   /** rx MAC source address */
+   int rxsa[EC_MAXBUF];
+   /** temporary rx buffer */
+   ec_bufT tempinbuf;
+} ecx_redportt;
+
+/** pointer structure to buffers, vars and mutexes for port instantiation */
+typedef struct
+{
+   ec_stackT   stack;
+   int         sockhandle;
+   /** simulated segment behind this port */
+   ec_simsegt  sim;
+   /** rx buffers */
+   ec_bufT rxbuf[EC_MAXBUF];
+   /** rx buffer status */
+   int rxbufstat[EC_MAXBUF];
+   /** rx MAC source address */
+   int rxsa[EC_MAXBUF];
+   /** temporary rx buffer */
+   ec_bufT tempinbuf;
+   /** temporary rx buffer status */
+   int tempinbufs;
+   /** transmit buffers */
+   ec_bufT txbuf[EC_MAXBUF];
+   /** transmit buffer lenghts */
+   int txbuflength[EC_MAXBUF];
+   /** temporary tx buffer */
+   ec_bufT txbuf2;
+   /** temporary tx buffer length */
+   int txbuflength2;
+   /** last used frame index */
+   uint8 lastidx;
+   /** current redundancy state */
+   int redstate;
+   /** pointer to redundancy port and buffers */
+   ecx_redportt *redport;
+   pthread_mutex_t getindex_mutex;
+   pthread_mutex_t tx_mutex;
+   pthread_mutex_t rx_mutex;
+} ecx_portt;
+
+extern const uint16 priMAC[3];
+extern const uint16 secMAC[3];
+
+#ifdef EC_VER1
+extern ecx_portt     ecx_port;
+extern ecx_redportt  ecx_redport;
+
+int ec_setupnic(const char * ifname, int secondary);
+int ec_closenic(void);
+void ec_setbufstat(uint8 idx, int bufstat);
+uint8 ec_getindex(void);
+int ec_outframe(uint8 idx, int sock);
+int ec_outframe_red(uint8 idx);
+int ec_queueframe_red(uint8 idx);
+int ec_flushframes(void);
+int ec_waitinframe(uint8 idx, int timeout);
+int ec_srconfirm(uint8 idx,int timeout);
+#endif
+
+void ec_setupheader(void *p);
+int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
+int ecx_closenic(ecx_portt *port);
+void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
+uint8 ecx_getindex(ecx_portt *port);
+int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
+int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_queueframe_red(ecx_portt *port, uint8 idx);
+int ecx_flushframes(ecx_portt *port);
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length);
+int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
+
+int ecx_sim_addslave(ecx_portt *port, const uint16 *sii, int words);
+int ecx_sim_buildsii(uint16 *sii, int words, uint32 man, uint32 id, uint32 rev,
+                     uint16 obits, uint16 ibits, boolean coe);
+uint8 *ecx_sim_slavemem(ecx_portt *port, uint16 position);
+void ecx_sim_clear(ecx_portt *port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "oshw.h"
+
+/**
+ * Host to Network byte order (i.e. to big endian).
+ *
+ * Note that Ethercat uses little endian byte order, except for the Ethernet
+ * header which is big endian as usual.
+ */
+uint16 oshw_htons(uint16 host)
+{
+   uint16 network = htons (host);
+   return network;
+}
+
+/**
+ * Network (i.e. big endian) to Host byte order.
+ *
+ * Note that Ethercat uses little endian byte order, except for the Ethernet
+ * header which is big endian as usual.
+ */
+uint16 oshw_ntohs(uint16 network)
+{
+   uint16 host = ntohs (network);
+   return host;
+}
+
+/** Create list over available network adapters. The simulated segment is
+ * the only adapter.
+ * @return First element in linked list of adapters
+ */
+ec_adaptert * oshw_find_adapters(void)
+{
+   ec_adaptert * adapter;
+
+   adapter = (ec_adaptert *)malloc(sizeof(ec_adaptert));
+   if (adapter)
+   {
+      adapter->next = NULL;
+      strncpy(adapter->name, "sim", EC_MAXLEN_ADAPTERNAME);
+      adapter->name[EC_MAXLEN_ADAPTERNAME-1] = '\0';
+      strncpy(adapter->desc, "Simulated EtherCAT segment", EC_MAXLEN_ADAPTERNAME);
+      adapter->desc[EC_MAXLEN_ADAPTERNAME-1] = '\0';
+   }
+
+   return adapter;
+}
+
+/** Free memory allocated memory used by adapter collection.
+ * @param[in] adapter = First element in linked list of adapters
+ * EC_NOFRAME.
+ */
+void oshw_free_adapters(ec_adaptert * adapter)
+{
+   ec_adaptert * next_adapter;
+   /* Iterate the linked list and free all elements holding
+    * adapter information
+    */
+   if(adapter)
+   {
+      next_adapter = adapter->next;
+      free (adapter);
+      while (next_adapter)
+      {
+         adapter = next_adapter;
+         next_adapter = adapter->next;
+         free (adapter);
+      }
+   }
+}
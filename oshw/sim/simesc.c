@@ -0,0 +1,1069 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Simulated EtherCAT slave controllers.
+ *
+ * A chain of ESCs is emulated in memory. Each slave owns a register and
+ * process RAM image, an SII EEPROM image and a small CoE object dictionary
+ * derived from the SII PDO categories. Frames are processed synchronously
+ * in the order the slaves are connected, applying the EtherCAT addressing
+ * and working counter rules per datagram:
+ *
+ * - auto increment (APxx, ARMW) addresses the slave where ADP reaches zero,
+ * - configured address (FPxx, FRMW) matches the station address register,
+ * - broadcast (BRD) reads are ORed over all slaves,
+ * - logical commands go through the FMMUs, reads add 1 and writes add 1,
+ *   or 2 in case of LRW, to the working counter per slave.
+ *
+ * Register side effects cover what the master needs to enumerate and
+ * configure slaves: AL control to AL status, the EEPROM interface, line
+ * topology in DL status and SyncManager mailboxes with a minimal SDO server.
+ * Distributed clocks are not emulated, the slaves report no DC support.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ethercattype.h"
+#include "nicdrv.h"
+#include "ethercatmain.h"
+#include "simesc.h"
+
+/** ESC information registers, read only */
+#define SIM_REG_INFOEND    0x0010
+/** FMMU register block size */
+#define SIM_FMMUSIZE       0x10
+/** SyncManager register block size */
+#define SIM_SMSIZE         0x08
+/** start of process RAM */
+#define SIM_PDRAM          0x1000
+/** mailbox full flag in SyncManager status */
+#define SIM_SMSTAT_FULL    0x08
+/** process data start of generated slaves, after the mailboxes */
+#define SIM_PDSTART        0x1100
+/** mailbox size of generated slaves */
+#define SIM_MBXSIZE        0x0080
+/** SII size of generated slaves in words */
+#define SIM_SIIWORDS       2048
+
+/** SDO abort codes used by the object dictionary */
+#define SIM_ABORT_NOOBJ    0x06020000
+#define SIM_ABORT_NOSUB    0x06090011
+#define SIM_ABORT_ACCESS   0x06010000
+#define SIM_ABORT_CMD      0x05040001
+/** mailbox error detail, protocol not supported */
+#define SIM_MBXERR_PROTO   0x0002
+
+static uint16 sim_get16(const uint8 *p)
+{
+   return (uint16)(p[0] | (p[1] << 8));
+}
+
+static void sim_put16(uint8 *p, uint16 v)
+{
+   p[0] = (uint8)v;
+   p[1] = (uint8)(v >> 8);
+}
+
+static uint32 sim_get32(const uint8 *p)
+{
+   return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static void sim_put32(uint8 *p, uint32 v)
+{
+   sim_put16(p, (uint16)v);
+   sim_put16(p + 2, (uint16)(v >> 16));
+}
+
+/** Byte access to a word organised SII image */
+static uint8 sim_siibyte(const uint16 *sii, int words, int addr)
+{
+   if ((addr >> 1) >= words)
+   {
+      return 0xff;
+   }
+   return (uint8)(sii[addr >> 1] >> ((addr & 1) * 8));
+}
+
+static void sim_siiput(uint16 *sii, int addr, uint8 v)
+{
+   if (addr & 1)
+   {
+      sii[addr >> 1] = (uint16)((sii[addr >> 1] & 0x00ff) | (v << 8));
+   }
+   else
+   {
+      sii[addr >> 1] = (uint16)((sii[addr >> 1] & 0xff00) | v);
+   }
+}
+
+/** Update DL status of a slave for a line topology. Port 0 always has
+ * communication, port 1 only if a slave follows. */
+static void sim_topology(ec_simslavet *sl, int last)
+{
+   uint16 dlstat;
+
+   dlstat = 0x0010 | 0x0200 | 0x1000 | 0x4000;
+   if (last)
+   {
+      dlstat |= 0x0400;
+   }
+   else
+   {
+      dlstat |= 0x0020 | 0x0800;
+   }
+   sim_put16(sl->mem + ECT_REG_DLSTAT, dlstat);
+}
+
+/** Load the registers that an ESC copies from SII after power up */
+static void sim_siiload(ec_simslavet *sl)
+{
+   sim_put16(sl->mem + ECT_REG_PDICTL, (sl->siiwords > 0) ? sl->sii[0] : 0);
+   sim_put16(sl->mem + ECT_REG_ALIAS, (sl->siiwords > 4) ? sl->sii[4] : 0);
+}
+
+/** Build CoE PDO objects from the SII TxPDO and RxPDO categories */
+static void sim_siipdo(ec_simslavet *sl)
+{
+   int w, a, end, cat, len, e, n;
+   ec_simpdot *pdo;
+
+   sl->npdo = 0;
+   w = ECT_SII_START;
+   while ((w + 1) < sl->siiwords)
+   {
+      cat = sl->sii[w];
+      len = sl->sii[w + 1];
+      if (cat == 0xffff)
+      {
+         break;
+      }
+      if ((cat == ECT_SII_PDO) || (cat == ECT_SII_PDO + 1))
+      {
+         a = (w + 2) << 1;
+         end = a + (len << 1);
+         while (((a + 8) <= end) && (sl->npdo < EC_SIMMAXPDO))
+         {
+            pdo = &sl->pdo[sl->npdo++];
+            pdo->index = (uint16)(sim_siibyte(sl->sii, sl->siiwords, a) |
+                                 (sim_siibyte(sl->sii, sl->siiwords, a + 1) << 8));
+            n = sim_siibyte(sl->sii, sl->siiwords, a + 2);
+            pdo->sm = sim_siibyte(sl->sii, sl->siiwords, a + 3);
+            pdo->nentry = 0;
+            a += 8;
+            for (e = 0; (e < n) && ((a + 8) <= end); e++, a += 8)
+            {
+               if (pdo->nentry < EC_SIMMAXPDOENTRY)
+               {
+                  pdo->entry[pdo->nentry++] =
+                     ((uint32)sim_siibyte(sl->sii, sl->siiwords, a) << 16) |
+                     ((uint32)sim_siibyte(sl->sii, sl->siiwords, a + 1) << 24) |
+                     ((uint32)sim_siibyte(sl->sii, sl->siiwords, a + 2) << 8) |
+                     sim_siibyte(sl->sii, sl->siiwords, a + 5);
+               }
+            }
+         }
+      }
+      w += 2 + len;
+   }
+}
+
+/** Add a slave at the end of the simulated segment */
+static int sim_addslave(ec_simsegt *seg, const uint16 *sii, int words)
+{
+   ec_simslavet *sl;
+   int n;
+
+   if (seg->slavecount >= seg->maxslaves)
+   {
+      n = seg->maxslaves ? seg->maxslaves * 2 : 64;
+      sl = realloc(seg->slave, n * sizeof(ec_simslavet));
+      if (!sl)
+      {
+         return -1;
+      }
+      if (!seg->maxslaves)
+      {
+         seg->loopback = 1;
+      }
+      seg->slave = sl;
+      seg->maxslaves = n;
+   }
+   sl = &seg->slave[seg->slavecount];
+   memset(sl, 0, sizeof(*sl));
+   sl->mem = calloc(1, EC_SIMMEMSIZE);
+   sl->sii = malloc(words * sizeof(uint16));
+   if (!sl->mem || !sl->sii)
+   {
+      free(sl->mem);
+      free(sl->sii);
+      return -1;
+   }
+   memcpy(sl->sii, sii, words * sizeof(uint16));
+   sl->siiwords = words;
+
+   sl->mem[ECT_REG_TYPE] = 0x11;
+   sl->mem[0x0004] = EC_SIMFMMU;
+   sl->mem[0x0005] = EC_SIMSM;
+   sl->mem[0x0006] = (EC_SIMMEMSIZE - SIM_PDRAM) >> 10;
+   sl->mem[ECT_REG_PORTDES] = 0x0f;
+   sim_put16(sl->mem + ECT_REG_ALSTAT, EC_STATE_INIT);
+   sim_put16(sl->mem + ECT_REG_EEPSTAT, EC_ESTAT_R64);
+   sim_siiload(sl);
+   sim_siipdo(sl);
+
+   if (seg->slavecount)
+   {
+      sim_topology(&seg->slave[seg->slavecount - 1], 0);
+   }
+   sim_topology(sl, 1);
+
+   return seg->slavecount++;
+}
+
+/** Add a slave at the end of the simulated segment. Slaves added before
+ * ecx_setupnic() replace the segment described by the interface name.
+ * @param[in] port        = port context struct
+ * @param[in] sii         = SII EEPROM image
+ * @param[in] words       = SII EEPROM size in words
+ * @return position of the new slave, or -1 on allocation failure
+ */
+int ecx_sim_addslave(ecx_portt *port, const uint16 *sii, int words)
+{
+   return sim_addslave(&(port->sim), sii, words);
+}
+
+/** Generate a SII EEPROM image for a simple I/O slave. Outputs are mapped
+ * to SM2 with RxPDOs 0x1600.., inputs to SM3 with TxPDOs 0x1A00.. . Entries
+ * are bytes when the bit count allows it, otherwise single bits.
+ * @param[out] sii        = SII EEPROM image
+ * @param[in]  words      = size of image buffer in words
+ * @param[in]  man        = vendor ID
+ * @param[in]  id         = product code
+ * @param[in]  rev        = revision number
+ * @param[in]  obits      = output bits
+ * @param[in]  ibits      = input bits
+ * @param[in]  coe        = TRUE to add a CoE mailbox
+ * @return number of words used, 0 if the image does not fit
+ */
+int ecx_sim_buildsii(uint16 *sii, int words, uint32 man, uint32 id, uint32 rev,
+                     uint16 obits, uint16 ibits, boolean coe)
+{
+   static const uint8 esize[] = { 8, 16, 32 };
+   char name[EC_MAXNAME + 1];
+   uint16 bits, sma, smbytes[2];
+   int a, cat, i, j, k, t, n, nstr, ebits, npdo, nent, mapped;
+
+   a = (ECT_SII_START + 2) << 1;
+   if (words <= ECT_SII_START + 64)
+   {
+      return 0;
+   }
+   memset(sii, 0, words * sizeof(uint16));
+   sii[0x0000] = 0x0005;
+   sii[ECT_SII_MANUF] = (uint16)man;
+   sii[ECT_SII_MANUF + 1] = (uint16)(man >> 16);
+   sii[ECT_SII_ID] = (uint16)id;
+   sii[ECT_SII_ID + 1] = (uint16)(id >> 16);
+   sii[ECT_SII_REV] = (uint16)rev;
+   sii[ECT_SII_REV + 1] = (uint16)(rev >> 16);
+   if (coe)
+   {
+      sii[ECT_SII_RXMBXADR] = SIM_PDRAM;
+      sii[ECT_SII_RXMBXADR + 1] = SIM_MBXSIZE;
+      sii[ECT_SII_TXMBXADR] = SIM_PDRAM + SIM_MBXSIZE;
+      sii[ECT_SII_TXMBXADR + 1] = SIM_MBXSIZE;
+      sii[ECT_SII_MBXPROTO] = ECT_MBXPROT_COE;
+   }
+   sii[0x003e] = (uint16)(((words * 16) >> 10) - 1);
+   sii[0x003f] = 0x0001;
+
+   /* strings */
+   cat = a;
+   snprintf(name, sizeof(name), "SIM O%u I%u%s", obits, ibits, coe ? " CoE" : "");
+   nstr = (int)strlen(name);
+   sim_siiput(sii, a++, 1);
+   sim_siiput(sii, a++, (uint8)nstr);
+   for (i = 0; i < nstr; i++)
+   {
+      sim_siiput(sii, a++, (uint8)name[i]);
+   }
+   a = (a + 1) & ~1;
+   sii[(cat >> 1) - 2] = ECT_SII_STRING;
+   sii[(cat >> 1) - 1] = (uint16)((a - cat) >> 1);
+
+   /* general */
+   a += 4;
+   cat = a;
+   sim_siiput(sii, a + 0, 1);
+   sim_siiput(sii, a + 1, 1);
+   sim_siiput(sii, a + 2, 1);
+   sim_siiput(sii, a + 3, 1);
+   sim_siiput(sii, a + 5, coe ? ECT_COEDET_SDO : 0);
+   a += 32;
+   sii[(cat >> 1) - 2] = ECT_SII_GENERAL;
+   sii[(cat >> 1) - 1] = 16;
+
+   /* FMMU usage: outputs, inputs, mailbox state */
+   a += 4;
+   cat = a;
+   sim_siiput(sii, a++, 1);
+   sim_siiput(sii, a++, 2);
+   sim_siiput(sii, a++, coe ? 3 : 0);
+   sim_siiput(sii, a++, 0);
+   sii[(cat >> 1) - 2] = ECT_SII_FMMU;
+   sii[(cat >> 1) - 1] = 2;
+
+   /* SyncManagers, SM0/SM1 mailbox or unused, SM2 outputs, SM3 inputs */
+   a += 4;
+   cat = a;
+   smbytes[0] = (uint16)((obits + 7) >> 3);
+   smbytes[1] = (uint16)((ibits + 7) >> 3);
+   if (SIM_PDSTART + smbytes[0] + smbytes[1] > EC_SIMMEMSIZE)
+   {
+      return 0;
+   }
+   for (i = 0; i < 4; i++, a += 8)
+   {
+      if (i < 2)
+      {
+         if (!coe)
+         {
+            continue;
+         }
+         sma = (uint16)(SIM_PDRAM + i * SIM_MBXSIZE);
+         n = SIM_MBXSIZE;
+         t = i ? 0x22 : 0x26;
+      }
+      else
+      {
+         sma = (uint16)((i == 2) ? SIM_PDSTART : SIM_PDSTART + smbytes[0]);
+         n = smbytes[i - 2];
+         t = (i == 2) ? 0x64 : 0x20;
+      }
+      sim_siiput(sii, a + 0, (uint8)sma);
+      sim_siiput(sii, a + 1, (uint8)(sma >> 8));
+      sim_siiput(sii, a + 2, (uint8)n);
+      sim_siiput(sii, a + 3, (uint8)(n >> 8));
+      sim_siiput(sii, a + 4, (uint8)t);
+      sim_siiput(sii, a + 6, n ? 1 : 0);
+   }
+   sii[(cat >> 1) - 2] = ECT_SII_SM;
+   sii[(cat >> 1) - 1] = 16;
+
+   /* TxPDO (inputs) and RxPDO (outputs) */
+   for (k = 0; k < 2; k++)
+   {
+      bits = k ? obits : ibits;
+      if (!bits)
+      {
+         continue;
+      }
+      ebits = 0;
+      for (i = 0; i < (int)sizeof(esize); i++)
+      {
+         if (((bits % esize[i]) == 0) && ((bits / esize[i]) <= EC_SIMMAXPDO * EC_SIMMAXPDOENTRY))
+         {
+            ebits = esize[i];
+            break;
+         }
+      }
+      if (!ebits)
+      {
+         if (bits > EC_SIMMAXPDO * EC_SIMMAXPDOENTRY)
+         {
+            return 0;
+         }
+         ebits = 1;
+      }
+      nent = bits / ebits;
+      npdo = (nent + EC_SIMMAXPDOENTRY - 1) / EC_SIMMAXPDOENTRY;
+      if (((a >> 1) + 4 + npdo * 4 + nent * 4) >= words)
+      {
+         return 0;
+      }
+      a += 4;
+      cat = a;
+      mapped = 0;
+      for (j = 0; j < npdo; j++)
+      {
+         n = nent - mapped;
+         if (n > EC_SIMMAXPDOENTRY)
+         {
+            n = EC_SIMMAXPDOENTRY;
+         }
+         t = (k ? 0x1600 : 0x1a00) + j;
+         sim_siiput(sii, a + 0, (uint8)t);
+         sim_siiput(sii, a + 1, (uint8)(t >> 8));
+         sim_siiput(sii, a + 2, (uint8)n);
+         sim_siiput(sii, a + 3, k ? 2 : 3);
+         a += 8;
+         t = (k ? 0x7000 : 0x6000) + (j << 4);
+         for (i = 0; i < n; i++, a += 8)
+         {
+            sim_siiput(sii, a + 0, (uint8)t);
+            sim_siiput(sii, a + 1, (uint8)(t >> 8));
+            sim_siiput(sii, a + 2, (uint8)(i + 1));
+            sim_siiput(sii, a + 4, (ebits == 1) ? 0x01 : (ebits == 8) ? 0x05 : (ebits == 16) ? 0x06 : 0x07);
+            sim_siiput(sii, a + 5, (uint8)ebits);
+         }
+         mapped += n;
+      }
+      sii[(cat >> 1) - 2] = (uint16)(ECT_SII_PDO + k);
+      sii[(cat >> 1) - 1] = (uint16)((a - cat) >> 1);
+   }
+   if ((a >> 1) >= words)
+   {
+      return 0;
+   }
+   sii[a >> 1] = 0xffff;
+
+   return (a >> 1) + 1;
+}
+
+/** Pointer to the register and process RAM image of a simulated slave, for
+ * inspecting outputs and injecting inputs.
+ * @param[in] port        = port context struct
+ * @param[in] position    = slave position, 0 is the first slave
+ * @return pointer to EC_SIMMEMSIZE bytes, NULL if slave does not exist
+ */
+uint8 *ecx_sim_slavemem(ecx_portt *port, uint16 position)
+{
+   if (position >= port->sim.slavecount)
+   {
+      return NULL;
+   }
+   return port->sim.slave[position].mem;
+}
+
+/** Remove all slaves from the simulated segment.
+ * @param[in] port        = port context struct
+ */
+void ecx_sim_clear(ecx_portt *port)
+{
+   ecx_sim_free(&(port->sim));
+}
+
+/** Free all simulated slaves of a segment.
+ * @param[in] seg         = simulated segment
+ */
+void ecx_sim_free(ec_simsegt *seg)
+{
+   int i;
+
+   for (i = 0; i < seg->slavecount; i++)
+   {
+      free(seg->slave[i].mem);
+      free(seg->slave[i].sii);
+   }
+   free(seg->slave);
+   seg->slave = NULL;
+   seg->slavecount = 0;
+   seg->maxslaves = 0;
+}
+
+/** Populate a segment from an interface name of the form
+ * "sim[:slaves[:outputbits[:inputbits[:coe]]]]".
+ * @param[in] seg         = simulated segment
+ * @param[in] spec        = interface name
+ * @return number of slaves, 0 on failure
+ */
+int ecx_sim_setup(ec_simsegt *seg, const char *spec)
+{
+   uint16 *sii;
+   int i, words;
+   int n = EC_SIMDEFSLAVES, obits = EC_SIMDEFBITS, ibits = EC_SIMDEFBITS, coe = 0;
+
+   if (strncmp(spec, "sim", 3) != 0)
+   {
+      return 0;
+   }
+   if (spec[3] == ':')
+   {
+      sscanf(spec + 4, "%d:%d:%d:%d", &n, &obits, &ibits, &coe);
+   }
+   if ((n <= 0) || (obits < 0) || (ibits < 0) || (obits > 0xffff) || (ibits > 0xffff))
+   {
+      return 0;
+   }
+   sii = malloc(SIM_SIIWORDS * sizeof(uint16));
+   if (!sii)
+   {
+      return 0;
+   }
+   words = ecx_sim_buildsii(sii, SIM_SIIWORDS, 0x00000002, 0x53494d00 | (coe ? 1 : 0), 1,
+                            (uint16)obits, (uint16)ibits, coe ? TRUE : FALSE);
+   for (i = 0; (i < n) && words; i++)
+   {
+      if (sim_addslave(seg, sii, words) < 0)
+      {
+         break;
+      }
+   }
+   free(sii);
+
+   return seg->slavecount;
+}
+
+/** Register bytes that the master can not write */
+static int sim_regro(uint16 ado)
+{
+   return (ado < SIM_REG_INFOEND) ||
+          ((ado >= ECT_REG_ALIAS) && (ado < ECT_REG_ALIAS + 2)) ||
+          ((ado >= ECT_REG_DLSTAT) && (ado < ECT_REG_DLSTAT + 2)) ||
+          ((ado >= ECT_REG_ALSTAT) && (ado < ECT_REG_ALSTAT + 6)) ||
+          ((ado >= ECT_REG_PDICTL) && (ado < ECT_REG_PDICTL + 2)) ||
+          ((ado >= ECT_REG_SM0) && (ado < ECT_REG_SM0 + EC_SIMSM * SIM_SMSIZE) &&
+           ((ado & (SIM_SMSIZE - 1)) == 5));
+}
+
+/** Find the first active SyncManager matching control mode and direction */
+static uint8 *sim_findsm(ec_simslavet *sl, uint8 ctl)
+{
+   uint8 *sm;
+   int i;
+
+   for (i = 0; i < EC_SIMSM; i++)
+   {
+      sm = sl->mem + ECT_REG_SM0 + i * SIM_SMSIZE;
+      if ((sm[6] & 0x01) && ((sm[4] & 0x0f) == ctl) && sim_get16(sm + 2))
+      {
+         return sm;
+      }
+   }
+   return NULL;
+}
+
+/** Object dictionary read, only the PDO configuration objects exist */
+static uint32 sim_odread(ec_simslavet *sl, uint16 index, uint8 sub, uint32 *val, int *size)
+{
+   int i, n;
+
+   if (index == ECT_SDO_SMCOMMTYPE)
+   {
+      if (sub > 4)
+      {
+         return SIM_ABORT_NOSUB;
+      }
+      *val = sub ? sub : 4;
+      *size = 1;
+      return 0;
+   }
+   if ((index >= ECT_SDO_PDOASSIGN) && (index < ECT_SDO_PDOASSIGN + EC_SIMSM))
+   {
+      n = 0;
+      for (i = 0; i < sl->npdo; i++)
+      {
+         if (sl->pdo[i].sm == (index - ECT_SDO_PDOASSIGN))
+         {
+            if (++n == sub)
+            {
+               *val = sl->pdo[i].index;
+               *size = 2;
+               return 0;
+            }
+         }
+      }
+      if (sub)
+      {
+         return SIM_ABORT_NOSUB;
+      }
+      *val = (uint32)n;
+      *size = 1;
+      return 0;
+   }
+   for (i = 0; i < sl->npdo; i++)
+   {
+      if (sl->pdo[i].index == index)
+      {
+         if (sub > sl->pdo[i].nentry)
+         {
+            return SIM_ABORT_NOSUB;
+         }
+         *val = sub ? sl->pdo[i].entry[sub - 1] : sl->pdo[i].nentry;
+         *size = sub ? 4 : 1;
+         return 0;
+      }
+   }
+   return SIM_ABORT_NOOBJ;
+}
+
+/** Handle a mailbox written by the master, answer in the read mailbox */
+static void sim_mailbox(ec_simslavet *sl, const uint8 *sm)
+{
+   uint8 *req, *rsp, *rsm;
+   uint16 index;
+   uint32 val = 0, abort;
+   int size = 0;
+
+   rsm = sim_findsm(sl, 0x02);
+   if (!rsm || (sim_get16(rsm + 2) < 16) || (sim_get16(sm + 2) < 16))
+   {
+      return;
+   }
+   req = sl->mem + sim_get16(sm);
+   rsp = sl->mem + sim_get16(rsm);
+   memset(rsp, 0, sim_get16(rsm + 2));
+   rsp[5] = req[5] & 0x70;
+   if ((req[5] & 0x0f) != ECT_MBXT_COE)
+   {
+      /* mailbox error, unsupported protocol */
+      sim_put16(rsp, 4);
+      rsp[5] |= ECT_MBXT_ERR;
+      sim_put16(rsp + 6, 0x0001);
+      sim_put16(rsp + 8, SIM_MBXERR_PROTO);
+   }
+   else
+   {
+      index = sim_get16(req + 9);
+      sim_put16(rsp, 10);
+      rsp[5] |= ECT_MBXT_COE;
+      sim_put16(rsp + 6, ECT_COES_SDORES << 12);
+      sim_put16(rsp + 9, index);
+      rsp[11] = req[11];
+      if ((sim_get16(req + 6) >> 12) != ECT_COES_SDOREQ)
+      {
+         abort = SIM_ABORT_CMD;
+      }
+      else if (req[8] == ECT_SDO_UP_REQ)
+      {
+         abort = sim_odread(sl, index, req[11], &val, &size);
+      }
+      else if (req[8] == ECT_SDO_UP_REQ_CA)
+      {
+         abort = SIM_ABORT_ACCESS;
+      }
+      else if ((req[8] & 0xe0) == 0x20)
+      {
+         /* downloads are accepted for existing objects and discarded */
+         abort = sim_odread(sl, index, req[11], &val, &size);
+         size = 0;
+      }
+      else
+      {
+         abort = SIM_ABORT_CMD;
+      }
+      if (abort)
+      {
+         sim_put16(rsp + 6, ECT_COES_SDOREQ << 12);
+         rsp[8] = ECT_SDO_ABORT;
+         sim_put32(rsp + 12, abort);
+      }
+      else if (size)
+      {
+         rsp[8] = (uint8)(0x43 | ((4 - size) << 2));
+         sim_put32(rsp + 12, val);
+      }
+      else
+      {
+         rsp[8] = 0x60;
+      }
+   }
+   rsm[5] |= SIM_SMSTAT_FULL;
+}
+
+/** EEPROM interface, commands complete immediately */
+static void sim_eeprom(ec_simslavet *sl)
+{
+   uint16 cmd;
+   uint32 addr;
+   int i;
+
+   cmd = sim_get16(sl->mem + ECT_REG_EEPCTL) & 0x0700;
+   addr = sim_get32(sl->mem + ECT_REG_EEPADR);
+   switch (cmd)
+   {
+      case EC_ECMD_READ:
+         for (i = 0; i < 4; i++)
+         {
+            sim_put16(sl->mem + ECT_REG_EEPDAT + 2 * i,
+                      ((addr + i) < (uint32)sl->siiwords) ? sl->sii[addr + i] : 0xffff);
+         }
+         break;
+      case EC_ECMD_WRITE & 0x0700:
+         if (addr < (uint32)sl->siiwords)
+         {
+            sl->sii[addr] = sim_get16(sl->mem + ECT_REG_EEPDAT);
+         }
+         break;
+      case EC_ECMD_RELOAD:
+         sim_siiload(sl);
+         break;
+      default:
+         break;
+   }
+   sim_put16(sl->mem + ECT_REG_EEPSTAT, EC_ESTAT_R64);
+}
+
+/** AL control, requested state is reached immediately */
+static void sim_alctl(ec_simslavet *sl)
+{
+   uint8 state = sl->mem[ECT_REG_ALCTL] & 0x0f;
+
+   if ((state == EC_STATE_INIT) || (state == EC_STATE_PRE_OP) || (state == EC_STATE_BOOT) ||
+       (state == EC_STATE_SAFE_OP) || (state == EC_STATE_OPERATIONAL))
+   {
+      sim_put16(sl->mem + ECT_REG_ALSTAT, state);
+      sim_put16(sl->mem + ECT_REG_ALSTATCODE, 0);
+   }
+   else if (!(sl->mem[ECT_REG_ALCTL] & EC_STATE_ACK))
+   {
+      sim_put16(sl->mem + ECT_REG_ALSTAT, (uint16)(sl->mem[ECT_REG_ALSTAT] | EC_STATE_ERROR));
+      sim_put16(sl->mem + ECT_REG_ALSTATCODE, 0x0011);
+   }
+}
+
+/** Returns TRUE if [ado, ado+len) contains addr */
+static int sim_hits(uint32 ado, uint32 len, uint32 addr)
+{
+   return (addr >= ado) && (addr < ado + len);
+}
+
+/** Physical read of slave memory into datagram data */
+static void sim_read(ec_simslavet *sl, uint16 ado, uint8 *data, uint16 len, int bor)
+{
+   uint8 *sm;
+   int i, n;
+
+   n = len;
+   if (ado + n > EC_SIMMEMSIZE)
+   {
+      n = (ado < EC_SIMMEMSIZE) ? EC_SIMMEMSIZE - ado : 0;
+   }
+   if (bor)
+   {
+      for (i = 0; i < n; i++)
+      {
+         data[i] |= sl->mem[ado + i];
+      }
+   }
+   else
+   {
+      memcpy(data, sl->mem + ado, n);
+   }
+   if ((ado + n > SIM_PDRAM) && (sm = sim_findsm(sl, 0x02)) &&
+       sim_hits(ado, n, sim_get16(sm) + sim_get16(sm + 2) - 1))
+   {
+      /* last byte of read mailbox read, mailbox is empty again */
+      sm[5] &= ~SIM_SMSTAT_FULL;
+   }
+}
+
+/** Physical write of datagram data into slave memory */
+static void sim_write(ec_simslavet *sl, uint16 ado, const uint8 *data, uint16 len)
+{
+   uint8 *sm;
+   int i, n;
+
+   n = len;
+   if (ado + n > EC_SIMMEMSIZE)
+   {
+      n = (ado < EC_SIMMEMSIZE) ? EC_SIMMEMSIZE - ado : 0;
+   }
+   if (ado < ECT_REG_DCTIME0)
+   {
+      for (i = 0; i < n; i++)
+      {
+         if (!sim_regro((uint16)(ado + i)))
+         {
+            sl->mem[ado + i] = data[i];
+         }
+      }
+      if (sim_hits(ado, n, ECT_REG_ALCTL))
+      {
+         sim_alctl(sl);
+      }
+      if (sim_hits(ado, n, ECT_REG_EEPCTL + 1))
+      {
+         sim_eeprom(sl);
+      }
+   }
+   else
+   {
+      memcpy(sl->mem + ado, data, n);
+   }
+   if ((ado + n > SIM_PDRAM) && (sm = sim_findsm(sl, 0x06)) &&
+       sim_hits(ado, n, sim_get16(sm) + sim_get16(sm + 2) - 1))
+   {
+      /* last byte of write mailbox written, process request */
+      sim_mailbox(sl, sm);
+   }
+}
+
+/** Physical read, write or exchange by a slave, returns WKC increment */
+static uint16 sim_physical(ec_simslavet *sl, uint8 rw, uint16 ado, uint8 *data, uint16 len, int bor)
+{
+   uint8 tmp[EC_BUFSIZE];
+
+   switch (rw)
+   {
+      case 1:
+         sim_read(sl, ado, data, len, bor);
+         return 1;
+      case 2:
+         sim_write(sl, ado, data, len);
+         return 1;
+      default:
+         memset(tmp, 0, len);
+         sim_read(sl, ado, tmp, len, 0);
+         sim_write(sl, ado, data, len);
+         if (bor)
+         {
+            while (len--)
+            {
+               data[len] |= tmp[len];
+            }
+         }
+         else
+         {
+            memcpy(data, tmp, len);
+         }
+         return 3;
+   }
+}
+
+/** Copy one FMMU mapped area between logical and physical memory */
+static void sim_fmmucopy(ec_simslavet *sl, const uint8 *fm, uint32 laddr, uint8 *data, uint16 len, int wr)
+{
+   uint32 ls, lb, le, pb, b, db, p;
+   uint16 ll;
+   uint8 lsb, leb, psb;
+
+   ls = sim_get32(fm);
+   ll = sim_get16(fm + 4);
+   lsb = fm[6] & 0x07;
+   leb = fm[7] & 0x07;
+   p = sim_get16(fm + 8);
+   psb = fm[10] & 0x07;
+   if ((lsb == 0) && (leb == 7) && (psb == 0))
+   {
+      /* byte mapping */
+      lb = (ls > laddr) ? ls : laddr;
+      le = ((ls + ll) < (laddr + len)) ? ls + ll : laddr + len;
+      p += lb - ls;
+      if ((lb >= le) || (p >= EC_SIMMEMSIZE))
+      {
+         return;
+      }
+      if (p + (le - lb) > EC_SIMMEMSIZE)
+      {
+         le = lb + EC_SIMMEMSIZE - p;
+      }
+      if (wr)
+      {
+         memcpy(sl->mem + p, data + (lb - laddr), le - lb);
+      }
+      else
+      {
+         memcpy(data + (lb - laddr), sl->mem + p, le - lb);
+      }
+      return;
+   }
+   /* bit mapping */
+   lb = (ls << 3) + lsb;
+   le = ((ls + ll - 1) << 3) + leb;
+   pb = (p << 3) + psb;
+   for (b = lb; b <= le; b++)
+   {
+      if ((b < (laddr << 3)) || (b >= ((laddr + len) << 3)))
+      {
+         continue;
+      }
+      db = b - (laddr << 3);
+      p = pb + (b - lb);
+      if ((p >> 3) >= EC_SIMMEMSIZE)
+      {
+         break;
+      }
+      if (wr)
+      {
+         sl->mem[p >> 3] = (uint8)((sl->mem[p >> 3] & ~(1 << (p & 7))) |
+                                   (((data[db >> 3] >> (db & 7)) & 1) << (p & 7)));
+      }
+      else
+      {
+         data[db >> 3] = (uint8)((data[db >> 3] & ~(1 << (db & 7))) |
+                                 (((sl->mem[p >> 3] >> (p & 7)) & 1) << (db & 7)));
+      }
+   }
+}
+
+/** Logical read and/or write through the FMMUs of a slave, returns WKC increment */
+static uint16 sim_logical(ec_simsegt *seg, ec_simslavet *sl, uint8 cmd, uint32 laddr, uint8 *data, uint16 len)
+{
+   uint8 *fm, *osm, *ism;
+   uint32 ls;
+   uint16 ll, n;
+   int f, pass, hit[2] = {0, 0};
+
+   /* writes are taken from the incoming frame, reads are inserted after */
+   for (pass = 1; pass >= 0; pass--)
+   {
+      if ((pass && (cmd == EC_CMD_LRD)) || (!pass && (cmd == EC_CMD_LWR)))
+      {
+         continue;
+      }
+      for (f = 0; f < EC_SIMFMMU; f++)
+      {
+         fm = sl->mem + ECT_REG_FMMU0 + f * SIM_FMMUSIZE;
+         if (!(fm[12] & 0x01) || !(fm[11] & (pass ? 0x02 : 0x01)))
+         {
+            continue;
+         }
+         ls = sim_get32(fm);
+         ll = sim_get16(fm + 4);
+         if (!ll || (ls >= laddr + len) || (ls + ll <= laddr))
+         {
+            continue;
+         }
+         sim_fmmucopy(sl, fm, laddr, data, len, pass);
+         hit[pass] = 1;
+      }
+      if (pass && hit[1] && seg->loopback)
+      {
+         /* application of the slave echoes outputs to inputs */
+         osm = sim_findsm(sl, 0x04);
+         ism = sim_findsm(sl, 0x00);
+         if (osm && ism)
+         {
+            n = sim_get16(osm + 2);
+            if (sim_get16(ism + 2) < n)
+            {
+               n = sim_get16(ism + 2);
+            }
+            if ((sim_get16(osm) + n <= EC_SIMMEMSIZE) && (sim_get16(ism) + n <= EC_SIMMEMSIZE))
+            {
+               memmove(sl->mem + sim_get16(ism), sl->mem + sim_get16(osm), n);
+            }
+         }
+      }
+   }
+   if (cmd == EC_CMD_LRW)
+   {
+      return (uint16)(hit[0] + 2 * hit[1]);
+   }
+   return (uint16)(hit[0] + hit[1]);
+}
+
+/** Process one datagram through all slaves of the segment */
+static void sim_datagram(ec_simsegt *seg, uint8 *dg, uint16 len)
+{
+   ec_simslavet *sl;
+   uint8 cmd, *data;
+   uint16 adp, ado, wkc, pos;
+   uint32 laddr;
+   int i;
+
+   cmd = dg[0];
+   adp = sim_get16(dg + 2);
+   ado = sim_get16(dg + 4);
+   data = dg + 10;
+   wkc = sim_get16(data + len);
+   switch (cmd)
+   {
+      case EC_CMD_APRD:
+      case EC_CMD_APWR:
+      case EC_CMD_APRW:
+         pos = (uint16)(0 - adp);
+         if (pos < seg->slavecount)
+         {
+            wkc += sim_physical(&seg->slave[pos], (uint8)(cmd - EC_CMD_APRD + 1), ado, data, len, 0);
+         }
+         adp = (uint16)(adp + seg->slavecount);
+         break;
+      case EC_CMD_FPRD:
+      case EC_CMD_FPWR:
+      case EC_CMD_FPRW:
+         for (i = 0; i < seg->slavecount; i++)
+         {
+            sl = &seg->slave[i];
+            if (sim_get16(sl->mem + ECT_REG_STADR) == adp)
+            {
+               wkc += sim_physical(sl, (uint8)(cmd - EC_CMD_FPRD + 1), ado, data, len, 0);
+            }
+         }
+         break;
+      case EC_CMD_BRD:
+      case EC_CMD_BWR:
+      case EC_CMD_BRW:
+         for (i = 0; i < seg->slavecount; i++)
+         {
+            wkc += sim_physical(&seg->slave[i], (uint8)(cmd - EC_CMD_BRD + 1), ado, data, len, 1);
+         }
+         adp = (uint16)(adp + seg->slavecount);
+         break;
+      case EC_CMD_LRD:
+      case EC_CMD_LWR:
+      case EC_CMD_LRW:
+         laddr = adp | ((uint32)ado << 16);
+         for (i = 0; i < seg->slavecount; i++)
+         {
+            wkc += sim_logical(seg, &seg->slave[i], cmd, laddr, data, len);
+         }
+         break;
+      case EC_CMD_ARMW:
+         pos = (uint16)(0 - adp);
+         for (i = 0; i < seg->slavecount; i++)
+         {
+            wkc += sim_physical(&seg->slave[i], (i == pos) ? 1 : 2, ado, data, len, 0);
+         }
+         adp = (uint16)(adp + seg->slavecount);
+         break;
+      case EC_CMD_FRMW:
+         for (i = 0; i < seg->slavecount; i++)
+         {
+            sl = &seg->slave[i];
+            wkc += sim_physical(sl, (sim_get16(sl->mem + ECT_REG_STADR) == adp) ? 1 : 2, ado, data, len, 0);
+         }
+         break;
+      default:
+         break;
+   }
+   sim_put16(dg + 2, adp);
+   sim_put16(data + len, wkc);
+   seg->datagrams++;
+}
+
+/** Pass an EtherCAT frame through the simulated segment. The frame is
+ * modified in place like it would be on the wire.
+ * @param[in]     seg     = simulated segment
+ * @param[in,out] frame   = ethernet frame
+ * @param[in]     length  = frame length in bytes
+ */
+void ecx_sim_process(ec_simsegt *seg, uint8 *frame, int length)
+{
+   uint8 *p, *end;
+   uint16 dlength, len;
+
+   if ((length < (int)(ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE)) ||
+       (frame[12] != (ETH_P_ECAT >> 8)) || (frame[13] != (ETH_P_ECAT & 0xff)))
+   {
+      return;
+   }
+   p = frame + ETH_HEADERSIZE;
+   end = p + EC_ELENGTHSIZE + (sim_get16(p) & 0x07ff);
+   if (end > frame + length)
+   {
+      end = frame + length;
+   }
+   p += EC_ELENGTHSIZE;
+   do
+   {
+      dlength = sim_get16(p + 6);
+      len = dlength & 0x07ff;
+      if (p + EC_HEADERSIZE - EC_ELENGTHSIZE + len + EC_WKCSIZE > end)
+      {
+         break;
+      }
+      sim_datagram(seg, p, len);
+      p += EC_HEADERSIZE - EC_ELENGTHSIZE + len + EC_WKCSIZE;
+   }
+   while (dlength & EC_DATAGRAMFOLLOWS);
+   seg->frames++;
+}
@@ -0,0 +1,27 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for simesc.c
+ */
+
+#ifndef _simesch_
+#define _simesch_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int ecx_sim_setup(ec_simsegt *seg, const char *spec);
+void ecx_sim_process(ec_simsegt *seg, uint8 *frame, int length);
+void ecx_sim_free(ec_simsegt *seg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
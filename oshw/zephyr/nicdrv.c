@@ -250,6 +250,35 @@ int ecx_outframe_red(ecx_portt *port, uint8 idx)
 	return rval;
 }
 
+int ecx_queueframe_red(ecx_portt *port, uint8 idx)
+{
+	/* no batched transmission, send right away */
+	return ecx_outframe_red(port, idx);
+}
+
+int ecx_flushframes(ecx_portt *port)
+{
+	(void)port;
+	return 0;
+}
+
+/** Have the data of a received datagram copied straight to its place. This
+ * port has no such receive path, the caller copies it from the rx buffer.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[in] data        = where the datagram data goes
+ * @param[in] length      = length of datagram data
+ * @return FALSE, the data is never placed
+ */
+int ecx_setrxplace(ecx_portt *port, uint8 idx, void *data, int length)
+{
+	(void)port;
+	(void)idx;
+	(void)data;
+	(void)length;
+	return FALSE;
+}
+
 static int ecx_recvpkt(ecx_portt *port, int stacknumber)
 {
 	int lp, bytesrx;
@@ -466,6 +495,16 @@ int ec_outframe_red(uint8 idx)
 	return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_queueframe_red(uint8 idx)
+{
+	return ecx_queueframe_red(&ecx_port, idx);
+}
+
+int ec_flushframes(void)
+{
+	return ecx_flushframes(&ecx_port);
+}
+
 int ec_inframe(uint8 idx, int stacknumber)
 {
 	return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -16,11 +16,13 @@
 #include "ethercatbase.h"
 #include "ethercatmain.h"
 #include "ethercatdc.h"
+#include "ethercatcyclic.h"
 #include "ethercatcoe.h"
 #include "ethercatfoe.h"
 #include "ethercatsoe.h"
 #include "ethercateoe.h"
 #include "ethercatconfig.h"
+#include "ethercatcache.h"
 #include "ethercatprint.h"
 
 #endif /* _EC_ETHERCAT_H */
@@ -162,6 +162,10 @@ int ecx_BWR (ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
 
    /* get fresh index */
    idx = ecx_getindex (port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    /* setup datagram */
    ecx_setupdatagram (port, &(port->txbuf[idx]), EC_CMD_BWR, idx, ADP, ADO, length, data);
    /* send data and wait for answer */
@@ -189,6 +193,10 @@ int ecx_BRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
 
    /* get fresh index */
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    /* setup datagram */
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_BRD, idx, ADP, ADO, length, data);
    /* send data and wait for answer */
@@ -220,6 +228,10 @@ int ecx_APRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    uint8 idx;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_APRD, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -248,6 +260,10 @@ int ecx_ARMW(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    uint8 idx;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_ARMW, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -276,6 +292,10 @@ int ecx_FRMW(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    uint8 idx;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FRMW, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -321,6 +341,10 @@ int ecx_FPRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    uint8 idx;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if (wkc > 0)
@@ -365,6 +389,10 @@ int ecx_APWR(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_APWR, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -402,6 +430,10 @@ int ecx_FPWR(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data,
    uint8 idx;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPWR, idx, ADP, ADO, length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -438,6 +470,10 @@ int ecx_LRW(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRW, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if ((wkc > 0) && (port->rxbuf[idx][EC_CMDOFFSET] == EC_CMD_LRW))
@@ -464,6 +500,10 @@ int ecx_LRD(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRD, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    if ((wkc > 0) && (port->rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD))
@@ -490,6 +530,10 @@ int ecx_LWR(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
    int wkc;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LWR, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    wkc = ecx_srconfirm(port, idx, timeout);
    ecx_setbufstat(port, idx, EC_BUF_EMPTY);
@@ -517,6 +561,10 @@ int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16
    uint64 DCtE;
 
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    /* LRW in first datagram */
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_LRW, idx, LO_WORD(LogAdr), HI_WORD(LogAdr), length, data);
    /* FPRMW in second datagram */
@@ -535,6 +583,179 @@ int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16
    return wkc;
 }
 
+/** Fill in a command of a datagram batch.
+ *
+ * @param[out] cmd        = batch command
+ * @param[in]  com        = command, EC_CMD_xxx
+ * @param[in]  ADP        = Address Position
+ * @param[in]  ADO        = Address Offset
+ * @param[in]  length     = length of databuffer
+ * @param[in,out] data    = databuffer to write, or to put slave data in
+ */
+void ecx_batchcmd(ec_batchcmdt *cmd, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data)
+{
+   cmd->command = com;
+   cmd->ADP = ADP;
+   cmd->ADO = ADO;
+   cmd->length = length;
+   cmd->data = data;
+   cmd->wkc = EC_NOFRAME;
+}
+
+/** Length a command adds to a frame behind other datagrams */
+#define EC_BATCHLENGTH(cmd) (EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE + (cmd)->length)
+
+/** Chain commands of a batch into one frame, as many as fit.
+ *
+ * @param[in] port        = port context struct
+ * @param[in,out] cmds    = commands of batch
+ * @param[in] first       = first command to put in the frame
+ * @param[in] ncmds       = number of commands in batch
+ * @param[in] idx         = index of the frame
+ * @return first command not in the frame
+ */
+static int ecx_batchframe(ecx_portt *port, ec_batchcmdt *cmds, int first, int ncmds, uint8 idx)
+{
+   ec_batchcmdt *cmd;
+   int i, txlength;
+   boolean more;
+
+   cmd = &cmds[first];
+   ecx_setupdatagram(port, &(port->txbuf[idx]), cmd->command, idx, cmd->ADP, cmd->ADO,
+                     cmd->length, cmd->data);
+   cmd->idx = idx;
+   cmd->rxoffset = EC_HEADERSIZE;
+   txlength = port->txbuflength[idx];
+   i = first + 1;
+   while ((i < ncmds) && (cmds[i].length <= EC_MAXLRWDATA) &&
+          ((txlength + EC_BATCHLENGTH(&cmds[i])) <= EC_MAXBATCHFRAME))
+   {
+      cmd = &cmds[i];
+      txlength += EC_BATCHLENGTH(cmd);
+      /* the flag of the last datagram must be clear, so look ahead */
+      more = ((i + 1) < ncmds) && (cmds[i + 1].length <= EC_MAXLRWDATA) &&
+             ((txlength + EC_BATCHLENGTH(&cmds[i + 1])) <= EC_MAXBATCHFRAME);
+      cmd->rxoffset = ecx_adddatagram(port, &(port->txbuf[idx]), cmd->command, idx, more,
+                                      cmd->ADP, cmd->ADO, cmd->length, cmd->data);
+      cmd->idx = idx;
+      i++;
+   }
+
+   return i;
+}
+
+/** Send a batch of commands and collect their results. Blocking.
+ * The commands are chained into as few frames as fit, up to
+ * EC_MAXBATCHFRAMES frames are sent in one burst and received together.
+ * Frames that do not return are sent again until timeout. The slaves
+ * execute the commands in the order of the list. For every command the WKC
+ * is stored, and for all but the write commands the returned data.
+ *
+ * @param[in] port        = port context struct
+ * @param[in,out] cmds    = commands of batch, see ecx_batchcmd()
+ * @param[in] ncmds       = number of commands
+ * @param[in] timeout     = timeout in us, standard is EC_TIMEOUTRET
+ * @return sum of the WKC of all commands, or EC_NOFRAME if no frame returned
+ */
+int ecx_batch(ecx_portt *port, ec_batchcmdt *cmds, int ncmds, int timeout)
+{
+   ec_batchcmdt *cmd;
+   uint8 idx[EC_MAXBATCHFRAMES];
+   int fwkc[EC_MAXBATCHFRAMES];
+   int first[EC_MAXBATCHFRAMES];
+   int last[EC_MAXBATCHFRAMES];
+   int next, nframes, f, i, wkc, pending;
+   uint16 le_wkc;
+   boolean valid;
+   osal_timert timer;
+
+   wkc = 0;
+   valid = FALSE;
+   next = 0;
+   while (next < ncmds)
+   {
+      /* build a burst of frames, commands that are too large are skipped */
+      nframes = 0;
+      while ((next < ncmds) && (nframes < EC_MAXBATCHFRAMES))
+      {
+         if (cmds[next].length > EC_MAXLRWDATA)
+         {
+            cmds[next++].wkc = EC_NOFRAME;
+            continue;
+         }
+         idx[nframes] = ecx_getindex(port);
+         if (idx[nframes] == EC_NOINDEX)
+         {
+            break;
+         }
+         fwkc[nframes] = EC_NOFRAME;
+         first[nframes] = next;
+         next = ecx_batchframe(port, cmds, next, ncmds, idx[nframes]);
+         last[nframes] = next;
+         nframes++;
+      }
+      if (nframes == 0)
+      {
+         /* no frame index free, the remaining commands are not sent */
+         while (next < ncmds)
+         {
+            cmds[next++].wkc = EC_NOFRAME;
+         }
+         break;
+      }
+      osal_timer_start(&timer, timeout);
+      do
+      {
+         for (f = 0; f < nframes; f++)
+         {
+            if (fwkc[f] <= EC_NOFRAME)
+            {
+               ecx_queueframe_red(port, idx[f]);
+            }
+         }
+         ecx_flushframes(port);
+         pending = 0;
+         for (f = 0; f < nframes; f++)
+         {
+            if (fwkc[f] <= EC_NOFRAME)
+            {
+               /* partial timeout for rx, same as ecx_srconfirm() */
+               fwkc[f] = ecx_waitinframe(port, idx[f], (timeout < EC_TIMEOUTRET) ? timeout : EC_TIMEOUTRET);
+               if (fwkc[f] <= EC_NOFRAME)
+               {
+                  pending++;
+               }
+            }
+         }
+      } while (pending && !osal_timer_is_expired(&timer));
+      for (f = 0; f < nframes; f++)
+      {
+         for (i = first[f]; i < last[f]; i++)
+         {
+            cmd = &cmds[i];
+            if (fwkc[f] <= EC_NOFRAME)
+            {
+               cmd->wkc = EC_NOFRAME;
+               continue;
+            }
+            memcpy(&le_wkc, &(port->rxbuf[idx[f]][cmd->rxoffset + cmd->length]), EC_WKCSIZE);
+            cmd->wkc = etohs(le_wkc);
+            wkc += cmd->wkc;
+            valid = TRUE;
+            if ((cmd->length > 0) && cmd->data &&
+                (cmd->command != EC_CMD_BWR) && (cmd->command != EC_CMD_APWR) &&
+                (cmd->command != EC_CMD_FPWR) && (cmd->command != EC_CMD_LWR))
+            {
+               memcpy(cmd->data, &(port->rxbuf[idx[f]][cmd->rxoffset]), cmd->length);
+            }
+         }
+         ecx_setbufstat(port, idx[f], EC_BUF_EMPTY);
+      }
+   }
+
+   return valid ? wkc : EC_NOFRAME;
+}
+
 #ifdef EC_VER1
 int ec_setupdatagram(void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data)
 {
@@ -634,4 +855,9 @@ int ec_LRWDC(uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtim
 {
    return ecx_LRWDC(&ecx_port, LogAdr, length, data, DCrs, DCtime, timeout);
 }
+
+int ec_batch(ec_batchcmdt *cmds, int ncmds, int timeout)
+{
+   return ecx_batch(&ecx_port, cmds, ncmds, timeout);
+}
 #endif
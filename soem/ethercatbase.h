@@ -16,6 +16,32 @@ extern "C"
 {
 #endif
 
+/** max. number of frames of a batch in flight at once */
+#define EC_MAXBATCHFRAMES 8
+/** max. length of a batch frame, ethernet header included and FCS excluded */
+#define EC_MAXBATCHFRAME  (EC_MAXECATFRAME - 4)
+
+/** One command of a datagram batch, see ecx_batch() */
+typedef struct ec_batchcmd
+{
+   /** command, EC_CMD_xxx */
+   uint8          command;
+   /** address position, or low word of a logical address */
+   uint16         ADP;
+   /** address offset, or high word of a logical address */
+   uint16         ADO;
+   /** length of data, at most EC_MAXLRWDATA */
+   uint16         length;
+   /** data sent by write commands, data returned by read commands */
+   void           *data;
+   /** WKC of the command, EC_NOFRAME if no answer */
+   int            wkc;
+   /** internal, frame index the command was sent with */
+   uint8          idx;
+   /** internal, offset of the command data in the rx frame */
+   uint16         rxoffset;
+} ec_batchcmdt;
+
 int ecx_setupdatagram(ecx_portt *port, void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data);
 uint16 ecx_adddatagram(ecx_portt *port, void *frame, uint8 com, uint8 idx, boolean more, uint16 ADP, uint16 ADO, uint16 length, void *data);
 int ecx_BWR(ecx_portt *port, uint16 ADP,uint16 ADO,uint16 length,void *data,int timeout);
@@ -34,6 +60,8 @@ int ecx_LRW(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
 int ecx_LRD(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout);
 int ecx_LWR(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout);
 int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtime, int timeout);
+void ecx_batchcmd(ec_batchcmdt *cmd, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data);
+int ecx_batch(ecx_portt *port, ec_batchcmdt *cmds, int ncmds, int timeout);
 
 #ifdef EC_VER1
 int ec_setupdatagram(void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data);
@@ -54,6 +82,7 @@ int ec_LRW(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LRD(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LWR(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LRWDC(uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtime, int timeout);
+int ec_batch(ec_batchcmdt *cmds, int ncmds, int timeout);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,308 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Slave cache for fast startup.
+ *
+ * Keeps the SII image and the resolved process data mapping of each slave
+ * position across restarts. The entry of a position is used as long as the
+ * slave found there has the same manufacturer, ID, revision, serial number
+ * and active ports, otherwise it is cleared and filled anew. SII bytes held
+ * in the entry are not read from the EEPROM again and a recorded mapping is
+ * not read through the mailbox again.
+ *
+ * The cache must be discarded when the EEPROM content or the PDO mapping of
+ * a slave is changed in a way its identity does not reflect.
+ */
+
+#include <string.h>
+#include "osal.h"
+#include "oshw.h"
+#include "ethercattype.h"
+#include "ethercatbase.h"
+#include "ethercatmain.h"
+#include "ethercatcache.h"
+
+/** Set up an empty slave cache and attach it to the context.
+ * @param[in]  context        = context struct
+ * @param[out] cache          = slave cache
+ * @param[in]  entry          = memory for the entries
+ * @param[in]  maxentries     = number of entries, slaves beyond are not cached
+ */
+void ecx_cache_init(ecx_contextt *context, ec_cachet *cache, ec_slavecachet *entry, int maxentries)
+{
+   memset(entry, 0, sizeof(ec_slavecachet) * maxentries);
+   cache->entry = entry;
+   cache->maxentries = maxentries;
+   cache->nentries = 0;
+   context->cache = cache;
+}
+
+/** Size of the image ecx_cache_serialize() writes for the entries in use.
+ * @param[in]  cache          = slave cache
+ * @return image size in bytes
+ */
+int ecx_cache_size(const ec_cachet *cache)
+{
+   return (int)(EC_CACHEHEADSIZE + (sizeof(ec_slavecachet) * cache->nentries));
+}
+
+/** Write the entries in use to an image the application keeps, for
+ * instance in a file, and gives to ecx_cache_deserialize() on the next
+ * start. The image is in host byte order.
+ * @param[in]  cache          = slave cache
+ * @param[out] buf            = image
+ * @param[in]  size           = size of buf in bytes, at least ecx_cache_size()
+ * @return image size in bytes, 0 if buf is too small
+ */
+int ecx_cache_serialize(const ec_cachet *cache, uint8 *buf, int size)
+{
+   uint32 head[4];
+   int length;
+
+   length = ecx_cache_size(cache);
+   if (size < length)
+   {
+      return 0;
+   }
+   head[0] = EC_CACHEMAGIC;
+   head[1] = EC_CACHEVERSION;
+   head[2] = sizeof(ec_slavecachet);
+   head[3] = (uint32)cache->nentries;
+   memcpy(buf, head, EC_CACHEHEADSIZE);
+   memcpy(&buf[EC_CACHEHEADSIZE], cache->entry, sizeof(ec_slavecachet) * cache->nentries);
+
+   return length;
+}
+
+/** Fill the slave cache from an image written by ecx_cache_serialize().
+ * Entries not in the image are cleared, an image of another format or
+ * version leaves the cache empty.
+ * @param[in]  cache          = slave cache
+ * @param[in]  buf            = image
+ * @param[in]  size           = image size in bytes
+ * @return number of entries loaded
+ */
+int ecx_cache_deserialize(ec_cachet *cache, const uint8 *buf, int size)
+{
+   uint32 head[4];
+   int n;
+
+   memset(cache->entry, 0, sizeof(ec_slavecachet) * cache->maxentries);
+   cache->nentries = 0;
+   if ((buf == NULL) || (size < EC_CACHEHEADSIZE))
+   {
+      return 0;
+   }
+   memcpy(head, buf, EC_CACHEHEADSIZE);
+   if ((head[0] != EC_CACHEMAGIC) ||
+       (head[1] != EC_CACHEVERSION) ||
+       (head[2] != sizeof(ec_slavecachet)))
+   {
+      return 0;
+   }
+   n = (head[3] < (uint32)cache->maxentries) ? (int)head[3] : cache->maxentries;
+   /* drop a truncated entry */
+   if (n > (int)((size - EC_CACHEHEADSIZE) / sizeof(ec_slavecachet)))
+   {
+      n = (int)((size - EC_CACHEHEADSIZE) / sizeof(ec_slavecachet));
+   }
+   memcpy(cache->entry, &buf[EC_CACHEHEADSIZE], sizeof(ec_slavecachet) * n);
+   cache->nentries = n;
+
+   return n;
+}
+
+/** Entry of a slave, if a cache is attached and the entry belongs to the
+ * slave now found at that position.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @return entry or NULL
+ */
+ec_slavecachet *ecx_cache_entry(ecx_contextt *context, uint16 slave)
+{
+   ec_cachet *cache = context->cache;
+   ec_slavecachet *entry;
+   ec_slavet *sl;
+
+   if ((cache == NULL) || (slave < 1) || (slave > cache->maxentries))
+   {
+      return NULL;
+   }
+   entry = &(cache->entry[slave - 1]);
+   sl = &(context->slavelist[slave]);
+   if ((entry->eep_man != sl->eep_man) ||
+       (entry->eep_id != sl->eep_id) ||
+       (entry->eep_rev != sl->eep_rev) ||
+       (entry->eep_sn != sl->eep_sn) ||
+       (entry->activeports != sl->activeports))
+   {
+      return NULL;
+   }
+
+   return entry;
+}
+
+/** Take the entry of a slave whose identity and topology have just been
+ * read. An entry recorded for another slave is cleared and given to it.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @return entry, NULL if no cache is attached or the slave is beyond it
+ */
+ec_slavecachet *ecx_cache_match(ecx_contextt *context, uint16 slave)
+{
+   ec_cachet *cache = context->cache;
+   ec_slavecachet *entry;
+   ec_slavet *sl;
+
+   if ((cache == NULL) || (slave < 1) || (slave > cache->maxentries))
+   {
+      return NULL;
+   }
+   entry = ecx_cache_entry(context, slave);
+   if (entry == NULL)
+   {
+      entry = &(cache->entry[slave - 1]);
+      sl = &(context->slavelist[slave]);
+      memset(entry, 0, sizeof(ec_slavecachet));
+      entry->eep_man = sl->eep_man;
+      entry->eep_id = sl->eep_id;
+      entry->eep_rev = sl->eep_rev;
+      entry->eep_sn = sl->eep_sn;
+      entry->activeports = sl->activeports;
+   }
+   if (slave > cache->nentries)
+   {
+      cache->nentries = slave;
+   }
+
+   return entry;
+}
+
+/** Forget the SII image and mapping of a slave, for instance after its
+ * EEPROM has been written.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ */
+void ecx_cache_invalidate(ecx_contextt *context, uint16 slave)
+{
+   ec_slavecachet *entry;
+
+   entry = ecx_cache_entry(context, slave);
+   if (entry)
+   {
+      entry->flags = 0;
+      memset(entry->siimap, 0, sizeof(entry->siimap));
+   }
+}
+
+/** Copy SII bytes from the image of an entry.
+ * @param[in]  entry          = cache entry
+ * @param[in]  address        = SII address in bytes
+ * @param[out] data           = bytes read
+ * @param[in]  length         = number of bytes
+ * @return TRUE if all bytes were in the image
+ */
+boolean ecx_cache_siiread(ec_slavecachet *entry, uint16 address, uint8 *data, int length)
+{
+   int a;
+
+   if ((address + length) > EC_MAXEEPBUF)
+   {
+      return FALSE;
+   }
+   for (a = address; a < (address + length); a++)
+   {
+      if (!(entry->siimap[a >> 5] & (1U << (a & 0x1f))))
+      {
+         return FALSE;
+      }
+   }
+   memcpy(data, &(entry->sii[address]), length);
+
+   return TRUE;
+}
+
+/** Put SII bytes read from the EEPROM into the image of an entry.
+ * @param[in]  entry          = cache entry
+ * @param[in]  address        = SII address in bytes
+ * @param[in]  data           = bytes read
+ * @param[in]  length         = number of bytes
+ */
+void ecx_cache_siiwrite(ec_slavecachet *entry, uint16 address, const uint8 *data, int length)
+{
+   int a;
+
+   if ((address + length) > EC_MAXEEPBUF)
+   {
+      return;
+   }
+   memcpy(&(entry->sii[address]), data, length);
+   for (a = address; a < (address + length); a++)
+   {
+      entry->siimap[a >> 5] |= (1U << (a & 0x1f));
+   }
+}
+
+/** Record the resolved mapping of a slave.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ */
+void ecx_cache_put_mapping(ecx_contextt *context, uint16 slave)
+{
+   ec_slavecachet *entry;
+   ec_slavet *sl;
+   int nSM;
+
+   entry = ecx_cache_entry(context, slave);
+   if (entry)
+   {
+      sl = &(context->slavelist[slave]);
+      for (nSM = 0; nSM < EC_MAXSM; nSM++)
+      {
+         entry->SMlength[nSM] = sl->SM[nSM].SMlength;
+         entry->SMtype[nSM] = sl->SMtype[nSM];
+      }
+      entry->Obits = sl->Obits;
+      entry->Ibits = sl->Ibits;
+      entry->flags |= EC_CACHE_MAPPED;
+   }
+}
+
+/** Set the mapping of a slave as recorded in its entry.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @return 1 if a recorded mapping was set, 0 otherwise
+ */
+int ecx_cache_get_mapping(ecx_contextt *context, uint16 slave)
+{
+   ec_slavecachet *entry;
+   ec_slavet *sl;
+   int nSM;
+
+   entry = ecx_cache_entry(context, slave);
+   if ((entry == NULL) || !(entry->flags & EC_CACHE_MAPPED))
+   {
+      return 0;
+   }
+   sl = &(context->slavelist[slave]);
+   for (nSM = 0; nSM < EC_MAXSM; nSM++)
+   {
+      sl->SM[nSM].SMlength = entry->SMlength[nSM];
+      sl->SMtype[nSM] = entry->SMtype[nSM];
+   }
+   sl->Obits = entry->Obits;
+   sl->Ibits = entry->Ibits;
+
+   return 1;
+}
+
+#ifdef EC_VER1
+void ec_cache_init(ec_cachet *cache, ec_slavecachet *entry, int maxentries)
+{
+   ecx_cache_init(&ecx_context, cache, entry, maxentries);
+}
+#endif
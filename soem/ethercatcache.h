@@ -0,0 +1,96 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for ethercatcache.c
+ */
+
+#ifndef _EC_ECATCACHE_H
+#define _EC_ECATCACHE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** magic number at the start of a cache image */
+#define EC_CACHEMAGIC     0x48434345
+/** cache image format version, images of other versions are ignored */
+#define EC_CACHEVERSION   1
+/** size of the header in front of the entries of a cache image */
+#define EC_CACHEHEADSIZE  16
+
+/** flag in ec_slavecachet.flags, set when the resolved mapping is recorded */
+#define EC_CACHE_MAPPED   0x01
+
+/** Cached data of the slave at one position. The entry is used only while
+ * the slave found there has the same identity and topology as recorded.
+ */
+typedef struct ec_slavecache
+{
+   /** manufacturer from EEPROM */
+   uint32           eep_man;
+   /** ID from EEPROM */
+   uint32           eep_id;
+   /** revision from EEPROM */
+   uint32           eep_rev;
+   /** serial number from EEPROM */
+   uint32           eep_sn;
+   /** active ports bitmap : ....3210 , set if respective port is active */
+   uint8            activeports;
+   /** EC_CACHE_MAPPED when Obits, Ibits, SMlength and SMtype are valid */
+   uint8            flags;
+   /** output bits of the resolved mapping */
+   uint16           Obits;
+   /** input bits of the resolved mapping */
+   uint16           Ibits;
+   /** SM lengths of the resolved mapping, in EtherCAT byte order */
+   uint16           SMlength[EC_MAXSM];
+   /** SM type 0=unused 1=MbxWr 2=MbxRd 3=Outputs 4=Inputs */
+   uint8            SMtype[EC_MAXSM];
+   /** bitmap of the SII bytes held in sii */
+   uint32           siimap[EC_MAXEEPBITMAP];
+   /** SII image as far as it was read */
+   uint8            sii[EC_MAXEEPBUF];
+} ec_slavecachet;
+
+/** Slave cache, one entry per slave position, storage supplied by the
+ * application. Set up with ecx_cache_init(), optionally filled from an image
+ * with ecx_cache_deserialize() before ecx_config_init(), and written to an
+ * image with ecx_cache_serialize() once the slaves are mapped. Storing the
+ * image, for instance in a file, is left to the application.
+ */
+struct ec_cache
+{
+   /** entries, entry n - 1 holds slave n */
+   ec_slavecachet   *entry;
+   /** number of entries */
+   int              maxentries;
+   /** number of entries in use */
+   int              nentries;
+};
+
+#ifdef EC_VER1
+void ec_cache_init(ec_cachet *cache, ec_slavecachet *entry, int maxentries);
+#endif
+
+void ecx_cache_init(ecx_contextt *context, ec_cachet *cache, ec_slavecachet *entry, int maxentries);
+int ecx_cache_size(const ec_cachet *cache);
+int ecx_cache_serialize(const ec_cachet *cache, uint8 *buf, int size);
+int ecx_cache_deserialize(ec_cachet *cache, const uint8 *buf, int size);
+ec_slavecachet *ecx_cache_entry(ecx_contextt *context, uint16 slave);
+ec_slavecachet *ecx_cache_match(ecx_contextt *context, uint16 slave);
+void ecx_cache_invalidate(ecx_contextt *context, uint16 slave);
+boolean ecx_cache_siiread(ec_slavecachet *entry, uint16 address, uint8 *data, int length);
+void ecx_cache_siiwrite(ec_slavecachet *entry, uint16 address, const uint8 *data, int length);
+void ecx_cache_put_mapping(ecx_contextt *context, uint16 slave);
+int ecx_cache_get_mapping(ecx_contextt *context, uint16 slave);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EC_ECATCACHE_H */
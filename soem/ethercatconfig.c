@@ -21,6 +21,7 @@
 #include "ethercatcoe.h"
 #include "ethercatsoe.h"
 #include "ethercatconfig.h"
+#include "ethercatcache.h"
 
 
 typedef struct
@@ -108,7 +109,7 @@ void ecx_init_context(ecx_contextt *context)
    memset(context->slavelist, 0x00, sizeof(ec_slavet) * context->maxslave);
    memset(context->grouplist, 0x00, sizeof(ec_groupt) * context->maxgroup);
    /* clear slave eeprom cache, does not actually read any eeprom */
-   ecx_siigetbyte(context, 0, EC_MAXEEPBUF);
+   ecx_siicache_clear(context);
    for(lp = 0; lp < context->maxgroup; lp++)
    {
       /* default start address per group entry */
@@ -253,164 +254,118 @@ static int ecx_config_from_table(ecx_contextt *context, uint16 slave)
 #endif
 
 /* If slave has SII and same slave ID done before, use previous data.
- * This is safe because SII is constant for same slave ID.
+ * This is safe because SII is constant for same slave ID. The slave done
+ * before is found through the identity index, see ecx_config_index().
  */
 static int ecx_lookup_prev_sii(ecx_contextt *context, uint16 slave)
 {
    int i, nSM;
-   if ((slave > 1) && (*(context->slavecount) > 0))
+   i = context->slavelist[slave].idfirst;
+   if (i > 0)
    {
-      i = 1;
-      while(((context->slavelist[i].eep_man != context->slavelist[slave].eep_man) ||
-             (context->slavelist[i].eep_id  != context->slavelist[slave].eep_id ) ||
-             (context->slavelist[i].eep_rev != context->slavelist[slave].eep_rev)) &&
-            (i < slave))
+      context->slavelist[slave].CoEdetails = context->slavelist[i].CoEdetails;
+      context->slavelist[slave].FoEdetails = context->slavelist[i].FoEdetails;
+      context->slavelist[slave].EoEdetails = context->slavelist[i].EoEdetails;
+      context->slavelist[slave].SoEdetails = context->slavelist[i].SoEdetails;
+      if(context->slavelist[i].blockLRW > 0)
       {
-         i++;
+         context->slavelist[slave].blockLRW = 1;
+         context->slavelist[0].blockLRW++;
       }
-      if(i < slave)
+      context->slavelist[slave].Ebuscurrent = context->slavelist[i].Ebuscurrent;
+      context->slavelist[0].Ebuscurrent += context->slavelist[slave].Ebuscurrent;
+      memcpy(context->slavelist[slave].name, context->slavelist[i].name, EC_MAXNAME + 1);
+      for( nSM=0 ; nSM < EC_MAXSM ; nSM++ )
       {
-         context->slavelist[slave].CoEdetails = context->slavelist[i].CoEdetails;
-         context->slavelist[slave].FoEdetails = context->slavelist[i].FoEdetails;
-         context->slavelist[slave].EoEdetails = context->slavelist[i].EoEdetails;
-         context->slavelist[slave].SoEdetails = context->slavelist[i].SoEdetails;
-         if(context->slavelist[i].blockLRW > 0)
-         {
-            context->slavelist[slave].blockLRW = 1;
-            context->slavelist[0].blockLRW++;
-         }
-         context->slavelist[slave].Ebuscurrent = context->slavelist[i].Ebuscurrent;
-         context->slavelist[0].Ebuscurrent += context->slavelist[slave].Ebuscurrent;
-         memcpy(context->slavelist[slave].name, context->slavelist[i].name, EC_MAXNAME + 1);
-         for( nSM=0 ; nSM < EC_MAXSM ; nSM++ )
-         {
-            context->slavelist[slave].SM[nSM].StartAddr = context->slavelist[i].SM[nSM].StartAddr;
-            context->slavelist[slave].SM[nSM].SMlength  = context->slavelist[i].SM[nSM].SMlength;
-            context->slavelist[slave].SM[nSM].SMflags   = context->slavelist[i].SM[nSM].SMflags;
-         }
-         context->slavelist[slave].FMMU0func = context->slavelist[i].FMMU0func;
-         context->slavelist[slave].FMMU1func = context->slavelist[i].FMMU1func;
-         context->slavelist[slave].FMMU2func = context->slavelist[i].FMMU2func;
-         context->slavelist[slave].FMMU3func = context->slavelist[i].FMMU3func;
-         EC_PRINT("Copy SII slave %d from %d.\n", slave, i);
-         return 1;
+         context->slavelist[slave].SM[nSM].StartAddr = context->slavelist[i].SM[nSM].StartAddr;
+         context->slavelist[slave].SM[nSM].SMlength  = context->slavelist[i].SM[nSM].SMlength;
+         context->slavelist[slave].SM[nSM].SMflags   = context->slavelist[i].SM[nSM].SMflags;
       }
+      context->slavelist[slave].FMMU0func = context->slavelist[i].FMMU0func;
+      context->slavelist[slave].FMMU1func = context->slavelist[i].FMMU1func;
+      context->slavelist[slave].FMMU2func = context->slavelist[i].FMMU2func;
+      context->slavelist[slave].FMMU3func = context->slavelist[i].FMMU3func;
+      EC_PRINT("Copy SII slave %d from %d.\n", slave, i);
+      return 1;
    }
    return 0;
 }
 
-/** Enumerate and init all slaves.
+/** Set the node address and frame handling of all slaves and read their
+ * interface type, alias, EEPROM status, DC support and topology. The
+ * register commands of EC_CONFIGBATCH
+ * slaves are sent as one batch instead of a round trip each.
  *
  * @param[in] context      = context struct
- * @param[in] usetable     = TRUE when using configtable to init slaves, FALSE otherwise
- * @return Workcounter of slave discover datagram = number of slaves found
  */
-int ecx_config_init(ecx_contextt *context, uint8 usetable)
+static void ecx_config_addresses(ecx_contextt *context)
 {
-   uint16 slave, ADPh, configadr, ssigen;
-   uint16 topology, estat;
-   int16 topoc, slavec, aliasadr;
-   uint8 b,h;
-   uint8 SMc;
-   uint32 eedat;
-   int wkc, cindex, nSM;
-   uint16 val16;
-
-   EC_PRINT("ec_config_init %d\n",usetable);
-   ecx_init_context(context);
-   wkc = ecx_detect_slaves(context);
-   if (wkc > 0)
+   ec_batchcmdt cmds[EC_CONFIGBATCH * 9];
+   uint16 stadr[EC_CONFIGBATCH], dlctl[EC_CONFIGBATCH], estat[EC_CONFIGBATCH];
+   uint16 escsup[EC_CONFIGBATCH], dlstat[EC_CONFIGBATCH], portdes[EC_CONFIGBATCH];
+   uint16 slave, fslave, lslave, ADPh, configadr, topology;
+   ec_slavet *sl;
+   uint8 b, h;
+   int n, i;
+
+   for (fslave = 1; fslave <= *(context->slavecount); fslave = lslave + 1)
    {
-      ecx_set_slaves_to_default(context);
-      for (slave = 1; slave <= *(context->slavecount); slave++)
+      lslave = fslave + EC_CONFIGBATCH - 1;
+      if (lslave > *(context->slavecount))
       {
+         lslave = (uint16)*(context->slavecount);
+      }
+      n = 0;
+      for (slave = fslave; slave <= lslave; slave++)
+      {
+         i = slave - fslave;
+         sl = &(context->slavelist[slave]);
          ADPh = (uint16)(1 - slave);
-         val16 = ecx_APRDw(context->port, ADPh, ECT_REG_PDICTL, EC_TIMEOUTRET3); /* read interface type of slave */
-         context->slavelist[slave].Itype = etohs(val16);
          /* a node offset is used to improve readability of network frames */
          /* this has no impact on the number of addressable slaves (auto wrap around) */
-         ecx_APWRw(context->port, ADPh, ECT_REG_STADR, htoes(slave + EC_NODEOFFSET) , EC_TIMEOUTRET3); /* set node address of slave */
-         if (slave == 1)
-         {
-            b = 1; /* kill non ecat frames for first slave */
-         }
-         else
-         {
-            b = 0; /* pass all frames for following slaves */
-         }
-         ecx_APWRw(context->port, ADPh, ECT_REG_DLCTL, htoes(b), EC_TIMEOUTRET3); /* set non ecat frame behaviour */
-         configadr = ecx_APRDw(context->port, ADPh, ECT_REG_STADR, EC_TIMEOUTRET3);
-         configadr = etohs(configadr);
-         context->slavelist[slave].configadr = configadr;
-         ecx_FPRD(context->port, configadr, ECT_REG_ALIAS, sizeof(aliasadr), &aliasadr, EC_TIMEOUTRET3);
-         context->slavelist[slave].aliasadr = etohs(aliasadr);
-         ecx_FPRD(context->port, configadr, ECT_REG_EEPSTAT, sizeof(estat), &estat, EC_TIMEOUTRET3);
-         estat = etohs(estat);
-         if (estat & EC_ESTAT_R64) /* check if slave can read 8 byte chunks */
-         {
-            context->slavelist[slave].eep_8byte = 1;
-         }
-         ecx_readeeprom1(context, slave, ECT_SII_MANUF); /* Manuf */
-      }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
-      {
-         eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* Manuf */
-         context->slavelist[slave].eep_man = etohl(eedat);
-         ecx_readeeprom1(context, slave, ECT_SII_SN); /* serial # */
-      }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
-      {
-         eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* serial # */
-         context->slavelist[slave].eep_sn = etohl(eedat);
-         ecx_readeeprom1(context, slave, ECT_SII_ID); /* ID */
-      }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
-      {
-         eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* ID */
-         context->slavelist[slave].eep_id = etohl(eedat);
-         ecx_readeeprom1(context, slave, ECT_SII_REV); /* revision */
-      }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
-      {
-         eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* revision */
-         context->slavelist[slave].eep_rev = etohl(eedat);
-         ecx_readeeprom1(context, slave, ECT_SII_RXMBXADR); /* write mailbox address + mailboxsize */
-      }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
-      {
-         eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* write mailbox address and mailboxsize */
-         context->slavelist[slave].mbx_wo = (uint16)LO_WORD(etohl(eedat));
-         context->slavelist[slave].mbx_l = (uint16)HI_WORD(etohl(eedat));
-         if (context->slavelist[slave].mbx_l > 0)
-         {
-            ecx_readeeprom1(context, slave, ECT_SII_TXMBXADR); /* read mailbox offset */
-         }
+         stadr[i] = htoes(slave + EC_NODEOFFSET);
+         /* kill non ecat frames for first slave, pass all frames for following slaves */
+         dlctl[i] = htoes((slave == 1) ? 1 : 0);
+         sl->Itype = 0;
+         sl->configadr = 0;
+         sl->aliasadr = 0;
+         estat[i] = 0;
+         escsup[i] = 0;
+         dlstat[i] = 0;
+         portdes[i] = 0;
+         configadr = slave + EC_NODEOFFSET;
+         ecx_batchcmd(&cmds[n++], EC_CMD_APRD, ADPh, ECT_REG_PDICTL, sizeof(sl->Itype), &(sl->Itype)); /* read interface type of slave */
+         ecx_batchcmd(&cmds[n++], EC_CMD_APWR, ADPh, ECT_REG_STADR, sizeof(stadr[i]), &stadr[i]); /* set node address of slave */
+         ecx_batchcmd(&cmds[n++], EC_CMD_APWR, ADPh, ECT_REG_DLCTL, sizeof(dlctl[i]), &dlctl[i]); /* set non ecat frame behaviour */
+         ecx_batchcmd(&cmds[n++], EC_CMD_APRD, ADPh, ECT_REG_STADR, sizeof(sl->configadr), &(sl->configadr));
+         /* the slave executes the commands in order, so the node address is set by now */
+         ecx_batchcmd(&cmds[n++], EC_CMD_FPRD, configadr, ECT_REG_ALIAS, sizeof(sl->aliasadr), &(sl->aliasadr));
+         ecx_batchcmd(&cmds[n++], EC_CMD_FPRD, configadr, ECT_REG_EEPSTAT, sizeof(estat[i]), &estat[i]);
+         ecx_batchcmd(&cmds[n++], EC_CMD_FPRD, configadr, ECT_REG_ESCSUP, sizeof(escsup[i]), &escsup[i]);
+         ecx_batchcmd(&cmds[n++], EC_CMD_FPRD, configadr, ECT_REG_DLSTAT, sizeof(dlstat[i]), &dlstat[i]);
+         ecx_batchcmd(&cmds[n++], EC_CMD_FPRD, configadr, ECT_REG_PORTDES, sizeof(portdes[i]), &portdes[i]);
       }
-      for (slave = 1; slave <= *(context->slavecount); slave++)
+      ecx_batch(context->port, cmds, n, EC_TIMEOUTRET3);
+      for (slave = fslave; slave <= lslave; slave++)
       {
-         if (context->slavelist[slave].mbx_l > 0)
+         i = slave - fslave;
+         sl = &(context->slavelist[slave]);
+         sl->Itype = etohs(sl->Itype);
+         sl->configadr = etohs(sl->configadr);
+         sl->aliasadr = etohs(sl->aliasadr);
+         if (etohs(estat[i]) & EC_ESTAT_R64) /* check if slave can read 8 byte chunks */
          {
-            eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP); /* read mailbox offset */
-            context->slavelist[slave].mbx_ro = (uint16)LO_WORD(etohl(eedat)); /* read mailbox offset */
-            context->slavelist[slave].mbx_rl = (uint16)HI_WORD(etohl(eedat)); /*read mailbox length */
-            if (context->slavelist[slave].mbx_rl == 0)
-            {
-               context->slavelist[slave].mbx_rl = context->slavelist[slave].mbx_l;
-            }
-            ecx_readeeprom1(context, slave, ECT_SII_MBXPROTO);
+            sl->eep_8byte = 1;
          }
-         configadr = context->slavelist[slave].configadr;
-         val16 = ecx_FPRDw(context->port, configadr, ECT_REG_ESCSUP, EC_TIMEOUTRET3);
-         if ((etohs(val16) & 0x04) > 0)  /* Support DC? */
+         if ((etohs(escsup[i]) & 0x04) > 0)  /* Support DC? */
          {
-            context->slavelist[slave].hasdc = TRUE;
+            sl->hasdc = TRUE;
          }
          else
          {
-            context->slavelist[slave].hasdc = FALSE;
+            sl->hasdc = FALSE;
          }
-         topology = ecx_FPRDw(context->port, configadr, ECT_REG_DLSTAT, EC_TIMEOUTRET3); /* extract topology from DL status */
-         topology = etohs(topology);
+         topology = etohs(dlstat[i]); /* extract topology from DL status */
          h = 0;
          b = 0;
          if ((topology & 0x0300) == 0x0200) /* port0 open and communication established */
@@ -434,10 +389,208 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             b |= 0x08;
          }
          /* ptype = Physical type*/
-         val16 = ecx_FPRDw(context->port, configadr, ECT_REG_PORTDES, EC_TIMEOUTRET3);
-         context->slavelist[slave].ptype = LO_BYTE(etohs(val16));
-         context->slavelist[slave].topology = h;
-         context->slavelist[slave].activeports = b;
+         sl->ptype = LO_BYTE(etohs(portdes[i]));
+         sl->topology = h;
+         sl->activeports = b;
+      }
+   }
+}
+
+/** Read the same SII word pair of some slaves in step. Words held in the
+ * image of a slave cache entry are taken from there, the others are read
+ * and put there unless the read failed.
+ *
+ * @param[in]  context      = context struct
+ * @param[in]  slaves       = slave numbers
+ * @param[in]  n            = number of slaves, at most EC_MAXEEPMULTI
+ * @param[in]  eeproma      = (WORD) Address in the EEPROM
+ * @param[out] edat         = EEPROM data 32bit per slave, 0 if not read
+ */
+static void ecx_config_sii_words(ecx_contextt *context, const uint16 *slaves, int n,
+                                 uint16 eeproma, uint32 *edat)
+{
+   uint16 rslaves[EC_MAXEEPMULTI];
+   uint32 rdat[EC_MAXEEPMULTI];
+   int rk[EC_MAXEEPMULTI];
+   ec_slavecachet *entry;
+   int k, m;
+
+   m = 0;
+   for (k = 0; k < n; k++)
+   {
+      entry = ecx_cache_entry(context, slaves[k]);
+      if (!entry || !ecx_cache_siiread(entry, eeproma << 1, (uint8 *)&edat[k], sizeof(edat[k])))
+      {
+         rk[m] = k;
+         rslaves[m++] = slaves[k];
+      }
+   }
+   if (m)
+   {
+      ecx_readeeprom_multi(context, rslaves, m, eeproma, rdat, EC_TIMEOUTEEP);
+      for (k = 0; k < m; k++)
+      {
+         edat[rk[k]] = rdat[k];
+         entry = ecx_cache_entry(context, rslaves[k]);
+         if (entry && rdat[k])
+         {
+            ecx_cache_siiwrite(entry, eeproma << 1, (uint8 *)&rdat[k], sizeof(rdat[k]));
+         }
+      }
+   }
+}
+
+/** Read the identity and mailbox words of the SII of all slaves. The slaves
+ * are read in step, EC_MAXEEPMULTI at a time, so each word takes a few
+ * round trips for all of them instead of a few per slave. The mailbox words
+ * are taken from the slave cache where it holds them.
+ *
+ * @param[in] context      = context struct
+ */
+static void ecx_config_sii_ident(ecx_contextt *context)
+{
+   uint16 slaves[EC_MAXEEPMULTI];
+   uint32 edat[EC_MAXEEPMULTI];
+   uint16 slave, fslave;
+   ec_slavet *sl;
+   int n, m, k;
+
+   for (fslave = 1; fslave <= *(context->slavecount); fslave += EC_MAXEEPMULTI)
+   {
+      n = 0;
+      for (slave = fslave; (slave <= *(context->slavecount)) && (n < EC_MAXEEPMULTI); slave++)
+      {
+         slaves[n++] = slave;
+      }
+      ecx_readeeprom_multi(context, slaves, n, ECT_SII_MANUF, edat, EC_TIMEOUTEEP); /* Manuf */
+      for (k = 0; k < n; k++)
+      {
+         context->slavelist[slaves[k]].eep_man = etohl(edat[k]);
+      }
+      ecx_readeeprom_multi(context, slaves, n, ECT_SII_SN, edat, EC_TIMEOUTEEP); /* serial # */
+      for (k = 0; k < n; k++)
+      {
+         context->slavelist[slaves[k]].eep_sn = etohl(edat[k]);
+      }
+      ecx_readeeprom_multi(context, slaves, n, ECT_SII_ID, edat, EC_TIMEOUTEEP); /* ID */
+      for (k = 0; k < n; k++)
+      {
+         context->slavelist[slaves[k]].eep_id = etohl(edat[k]);
+      }
+      ecx_readeeprom_multi(context, slaves, n, ECT_SII_REV, edat, EC_TIMEOUTEEP); /* revision */
+      for (k = 0; k < n; k++)
+      {
+         context->slavelist[slaves[k]].eep_rev = etohl(edat[k]);
+         /* identity known, take the slave cache entry of the slave */
+         ecx_cache_match(context, slaves[k]);
+      }
+      ecx_config_sii_words(context, slaves, n, ECT_SII_RXMBXADR, edat); /* write mailbox address + mailboxsize */
+      for (k = 0; k < n; k++)
+      {
+         sl = &(context->slavelist[slaves[k]]);
+         sl->mbx_wo = (uint16)LO_WORD(etohl(edat[k]));
+         sl->mbx_l = (uint16)HI_WORD(etohl(edat[k]));
+      }
+      /* the read mailbox and protocols only of slaves that have a mailbox */
+      m = 0;
+      for (k = 0; k < n; k++)
+      {
+         if (context->slavelist[slaves[k]].mbx_l > 0)
+         {
+            slaves[m++] = slaves[k];
+         }
+      }
+      n = m;
+      if (n)
+      {
+         ecx_config_sii_words(context, slaves, n, ECT_SII_TXMBXADR, edat); /* read mailbox offset */
+         for (k = 0; k < n; k++)
+         {
+            sl = &(context->slavelist[slaves[k]]);
+            sl->mbx_ro = (uint16)LO_WORD(etohl(edat[k])); /* read mailbox offset */
+            sl->mbx_rl = (uint16)HI_WORD(etohl(edat[k])); /*read mailbox length */
+            if (sl->mbx_rl == 0)
+            {
+               sl->mbx_rl = sl->mbx_l;
+            }
+         }
+         ecx_config_sii_words(context, slaves, n, ECT_SII_MBXPROTO, edat);
+         for (k = 0; k < n; k++)
+         {
+            context->slavelist[slaves[k]].mbx_proto = (uint16)etohl(edat[k]);
+         }
+      }
+   }
+}
+
+/** Link every slave to the first slave with the same manufacturer, ID and
+ * revision, so the data of identical slaves is copied without searching
+ * the slaves before. Open addressing hash table of the first slave of each
+ * identity, slaves of an identity that does not fit are not linked.
+ *
+ * @param[in] context      = context struct
+ */
+static void ecx_config_index(ecx_contextt *context)
+{
+   uint16 table[EC_IDENTHASH];
+   ec_slavet *sl, *fsl;
+   uint32 h;
+   uint16 slave;
+   int n, i;
+
+   memset(table, 0, sizeof(table));
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      sl = &(context->slavelist[slave]);
+      sl->idfirst = 0;
+      h = (((sl->eep_man * 31) + sl->eep_id) * 31) + sl->eep_rev;
+      h ^= h >> 16;
+      for (n = 0; n < EC_IDENTHASH; n++)
+      {
+         i = (int)((h + n) & (EC_IDENTHASH - 1));
+         if (!table[i])
+         {
+            table[i] = slave;
+            break;
+         }
+         fsl = &(context->slavelist[table[i]]);
+         if ((fsl->eep_man == sl->eep_man) &&
+             (fsl->eep_id == sl->eep_id) &&
+             (fsl->eep_rev == sl->eep_rev))
+         {
+            sl->idfirst = table[i];
+            break;
+         }
+      }
+   }
+}
+
+/** Enumerate and init all slaves.
+ *
+ * @param[in] context      = context struct
+ * @param[in] usetable     = TRUE when using configtable to init slaves, FALSE otherwise
+ * @return Workcounter of slave discover datagram = number of slaves found
+ */
+int ecx_config_init(ecx_contextt *context, uint8 usetable)
+{
+   uint16 slave, configadr, ssigen;
+   uint16 topology;
+   int16 topoc, slavec;
+   uint8 SMc;
+   int wkc, cindex, nSM;
+
+   EC_PRINT("ec_config_init %d\n",usetable);
+   ecx_init_context(context);
+   wkc = ecx_detect_slaves(context);
+   if (wkc > 0)
+   {
+      ecx_set_slaves_to_default(context);
+      ecx_config_addresses(context);
+      ecx_config_sii_ident(context);
+      ecx_config_index(context);
+      for (slave = 1; slave <= *(context->slavecount); slave++)
+      {
+         configadr = context->slavelist[slave].configadr;
          /* 0=no links, not possible             */
          /* 1=1 link  , end of line              */
          /* 2=2 links , one before and one after */
@@ -489,8 +642,6 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
             context->slavelist[slave].SM[1].StartAddr = htoes(context->slavelist[slave].mbx_ro);
             context->slavelist[slave].SM[1].SMlength = htoes(context->slavelist[slave].mbx_rl);
             context->slavelist[slave].SM[1].SMflags = htoel(EC_DEFAULTMBXSM1);
-            eedat = ecx_readeeprom2(context, slave, EC_TIMEOUTEEP);
-            context->slavelist[slave].mbx_proto = (uint16)etohl(eedat);
          }
          cindex = 0;
          /* use configuration table ? */
@@ -611,39 +762,57 @@ int ecx_config_init(ecx_contextt *context, uint8 usetable)
 }
 
 /* If slave has SII mapping and same slave ID done before, use previous mapping.
- * This is safe because SII mapping is constant for same slave ID.
+ * This is safe because SII mapping is constant for same slave ID. A CoE or
+ * SoE mapping is only copied when the application allows it, see
+ * ecx_twin_mapping().
  */
 static int ecx_lookup_mapping(ecx_contextt *context, uint16 slave, uint32 *Osize, uint32 *Isize)
 {
    int i, nSM;
-   if ((slave > 1) && (*(context->slavecount) > 0))
+   i = context->slavelist[slave].idfirst;
+   if (i > 0)
    {
-      i = 1;
-      while(((context->slavelist[i].eep_man != context->slavelist[slave].eep_man) ||
-             (context->slavelist[i].eep_id  != context->slavelist[slave].eep_id ) ||
-             (context->slavelist[i].eep_rev != context->slavelist[slave].eep_rev)) &&
-            (i < slave))
-      {
-         i++;
-      }
-      if(i < slave)
+      for( nSM=0 ; nSM < EC_MAXSM ; nSM++ )
       {
-         for( nSM=0 ; nSM < EC_MAXSM ; nSM++ )
-         {
-            context->slavelist[slave].SM[nSM].SMlength = context->slavelist[i].SM[nSM].SMlength;
-            context->slavelist[slave].SMtype[nSM] = context->slavelist[i].SMtype[nSM];
-         }
-         *Osize = context->slavelist[i].Obits;
-         *Isize = context->slavelist[i].Ibits;
-         context->slavelist[slave].Obits = (uint16)*Osize;
-         context->slavelist[slave].Ibits = (uint16)*Isize;
-         EC_PRINT("Copy mapping slave %d from %d.\n", slave, i);
-         return 1;
+         context->slavelist[slave].SM[nSM].SMlength = context->slavelist[i].SM[nSM].SMlength;
+         context->slavelist[slave].SMtype[nSM] = context->slavelist[i].SMtype[nSM];
       }
+      *Osize = context->slavelist[i].Obits;
+      *Isize = context->slavelist[i].Ibits;
+      context->slavelist[slave].Obits = (uint16)*Osize;
+      context->slavelist[slave].Ibits = (uint16)*Isize;
+      EC_PRINT("Copy mapping slave %d from %d.\n", slave, i);
+      return 1;
    }
    return 0;
 }
 
+/** Check if the CoE or SoE mapping of a slave can be copied from the first
+ * identical slave instead of being read through the mailbox. Only if the
+ * context has reusemapping set, no PO2SO hook may change the mapping of
+ * either, and the first one is in the same group, so it is mapped by the
+ * time ecx_map_sii() copies it.
+ *
+ * @param[in] context      = context struct
+ * @param[in] slave        = slave number
+ * @return TRUE if the mapping is copied
+ */
+static boolean ecx_twin_mapping(ecx_contextt *context, uint16 slave)
+{
+   ec_slavet *sl, *fsl;
+
+   sl = &(context->slavelist[slave]);
+   if (!context->reusemapping || !sl->idfirst)
+   {
+      return FALSE;
+   }
+   fsl = &(context->slavelist[sl->idfirst]);
+
+   return (!sl->PO2SOconfig && !sl->PO2SOconfigx &&
+           !fsl->PO2SOconfig && !fsl->PO2SOconfigx &&
+           !fsl->configindex && (fsl->group == sl->group));
+}
+
 static int ecx_map_coe_soe(ecx_contextt *context, uint16 slave, int thread_n)
 {
    uint32 Isize, Osize;
@@ -663,8 +832,25 @@ static int ecx_map_coe_soe(ecx_contextt *context, uint16 slave, int thread_n)
    {
       context->slavelist[slave].PO2SOconfigx(context, slave);
    }
+   /* mapping recorded in the slave cache, no need to read it again, unless
+    * a PO2SO hook may have changed it */
+   if (!context->slavelist[slave].configindex &&
+       !context->slavelist[slave].PO2SOconfig &&
+       !context->slavelist[slave].PO2SOconfigx &&
+       ecx_cache_get_mapping(context, slave))
+   {
+      EC_PRINT("  Cached Osize:%u Isize:%u\n",
+               context->slavelist[slave].Obits, context->slavelist[slave].Ibits);
+   }
+   /* identical slave mapped before, ecx_map_sii() copies its mapping */
+   else if (!context->slavelist[slave].configindex && ecx_twin_mapping(context, slave))
+   {
+      context->slavelist[slave].Obits = 0;
+      context->slavelist[slave].Ibits = 0;
+      EC_PRINT("  Mapping from slave %d\n", context->slavelist[slave].idfirst);
+   }
    /* if slave not found in configlist find IO mapping in slave self */
-   if (!context->slavelist[slave].configindex)
+   else if (!context->slavelist[slave].configindex)
    {
       Isize = 0;
       Osize = 0;
@@ -741,6 +927,7 @@ static int ecx_map_sii(ecx_contextt *context, uint16 slave)
    context->slavelist[slave].Ibits = (uint16)Isize;
    EC_PRINT("     ISIZE:%d %d OSIZE:%d\n",
       context->slavelist[slave].Ibits, Isize,context->slavelist[slave].Obits);
+   ecx_cache_put_mapping(context, slave);
 
    return 1;
 }
@@ -1365,6 +1552,8 @@ static int ecx_main_config_map_group(ecx_contextt *context, void *pIOmap, uint8
             context->slavelist[0].Obytes; /* store input bytes in master record */
       }
 
+      ecx_compile_processdata(context, group, FALSE);
+
       EC_PRINT("IOmapSize %d\n", LogAddr - context->grouplist[group].logstartaddr);
 
       return (LogAddr - context->grouplist[group].logstartaddr);
@@ -1537,6 +1726,8 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
          context->slavelist[0].Ibytes = siLogAddr - context->grouplist[group].logstartaddr;
       }
 
+      ecx_compile_processdata(context, group, TRUE);
+
       EC_PRINT("IOmapSize %d\n", context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
 
       return (context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
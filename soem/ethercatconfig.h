@@ -18,6 +18,11 @@ extern "C"
 
 #define EC_NODEOFFSET      0x1000
 #define EC_TEMPNODE        0xffff
+/** number of slaves set up with one command batch in ecx_config_init() */
+#define EC_CONFIGBATCH     16
+/** size of the identity index of ecx_config_init(), power of 2, more
+ * different slave identities than this are not indexed */
+#define EC_IDENTHASH       512
 
 #ifdef EC_VER1
 int ec_config_init(uint8 usetable);
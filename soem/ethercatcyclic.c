@@ -0,0 +1,327 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Cyclic process data engine.
+ *
+ * Runs the process data exchange of one group in a realtime thread that
+ * wakes on absolute deadlines, so the cycle does not drift by the time spent
+ * in the exchange itself. With a DC reference clock in the group the wakeup
+ * can be phase locked to the DC sync point.
+ *
+ * In multirate mode the cycle is a base tick. Every group with a divisor is
+ * due on the ticks that are a multiple of its divisor, shifted by its phase.
+ * The frames of all due groups are sent in one burst and received against
+ * one deadline, so slow groups only take bandwidth on their own ticks.
+ *
+ * Optionally the inputs and outputs are passed to application threads
+ * through triple buffered process images, so they never see an image the
+ * cyclic thread is halfway copying.
+ */
+
+#include <string.h>
+#include "oshw.h"
+#include "osal.h"
+#include "ethercattype.h"
+#include "ethercatbase.h"
+#include "ethercatmain.h"
+#include "ethercatcyclic.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define EC_XCHG(p, v) _InterlockedExchange((volatile long *)(p), (v))
+#else
+#define EC_XCHG(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
+/** Hand the write buffer to the consumer and take the middle one back.
+ * @param[in]  image          = process image
+ */
+static void ecx_pdimage_swap(ec_pdimaget *image)
+{
+   image->back = EC_XCHG(&(image->middle), image->back | EC_PDIMAGE_FRESH) & EC_PDIMAGE_INDEX;
+}
+
+/** Take the newest committed buffer if there is one.
+ * @param[in]  image          = process image
+ * @return TRUE if a new buffer was taken
+ */
+static boolean ecx_pdimage_take(ec_pdimaget *image)
+{
+   if (!(image->middle & EC_PDIMAGE_FRESH))
+   {
+      return FALSE;
+   }
+   image->front = EC_XCHG(&(image->middle), image->front) & EC_PDIMAGE_INDEX;
+
+   return TRUE;
+}
+
+/** Set up a triple buffered process image, all buffers cleared.
+ * @param[out] image          = process image
+ * @param[in]  buf            = memory for the buffers, 3 * size bytes
+ * @param[in]  size           = size of one image in bytes
+ */
+void ecx_pdimage_init(ec_pdimaget *image, void *buf, uint32 size)
+{
+   memset(buf, 0, 3 * (size_t)size);
+   image->buf = buf;
+   image->size = size;
+   image->back = 0;
+   image->middle = 1;
+   image->front = 2;
+}
+
+/** Buffer of the producer, valid until the next ecx_pdimage_commit().
+ * @param[in]  image          = process image
+ * @return pointer to the write buffer
+ */
+uint8 *ecx_pdimage_write(ec_pdimaget *image)
+{
+   return image->buf + (image->back * image->size);
+}
+
+/** Commit the write buffer to the consumer. The new write buffer starts as
+ * a copy of the committed one, so the producer may update only part of it.
+ * @param[in]  image          = process image
+ */
+void ecx_pdimage_commit(ec_pdimaget *image)
+{
+   uint8 *committed;
+
+   committed = ecx_pdimage_write(image);
+   ecx_pdimage_swap(image);
+   memcpy(ecx_pdimage_write(image), committed, image->size);
+}
+
+/** Newest committed buffer of the consumer, valid until the next call.
+ * @param[in]  image          = process image
+ * @return pointer to the read buffer
+ */
+uint8 *ecx_pdimage_read(ec_pdimaget *image)
+{
+   ecx_pdimage_take(image);
+
+   return image->buf + (image->front * image->size);
+}
+
+/** Correct the next wakeup so the cycle keeps dcshift ns behind the DC sync
+ * point of the reference clock. Simple PI controller on the phase error of
+ * the last DC time read.
+ * @param[in]  cyclic         = cyclic engine
+ */
+static void ecx_cyclic_dcsync(ec_cyclict *cyclic)
+{
+   int64 delta;
+
+   delta = (*(cyclic->context->DCtime) - cyclic->dcshift) % cyclic->cycletime;
+   if (delta > (cyclic->cycletime / 2))
+   {
+      delta -= cyclic->cycletime;
+   }
+   if (delta > 0)
+   {
+      cyclic->dcintegral++;
+   }
+   if (delta < 0)
+   {
+      cyclic->dcintegral--;
+   }
+   cyclic->dcoffset = -(delta / 100) - (cyclic->dcintegral / 20);
+}
+
+/** Exchange the groups due on this tick. Their frames are queued together
+ * and flushed once, then received against a common deadline.
+ * @param[in]  cyclic         = cyclic engine
+ */
+static void ecx_cyclic_multirate(ec_cyclict *cyclic)
+{
+   ecx_contextt *context = cyclic->context;
+   ec_groupt *grp;
+   uint8 due[256];
+   int g, n, i;
+   int64 deadline;
+
+   n = 0;
+   for (g = 0; (g < context->maxgroup) && (g < 256); g++)
+   {
+      grp = &(context->grouplist[g]);
+      if (grp->divisor && ((cyclic->cycles % grp->divisor) == (uint64)(grp->phase % grp->divisor)))
+      {
+         due[n++] = (uint8)g;
+      }
+   }
+   cyclic->wkc = 0;
+   if (!n)
+   {
+      return;
+   }
+   if (cyclic->use_overlap_io)
+   {
+      ecx_send_overlap_processdata_groups(context, due, n);
+   }
+   else
+   {
+      ecx_send_processdata_groups(context, due, n);
+   }
+   deadline = osal_monotonic_ns() + ((int64)cyclic->timeout * 1000);
+   for (i = 0; i < n; i++)
+   {
+      grp = &(context->grouplist[due[i]]);
+      grp->wkc = ecx_receive_processdata_group_deadline(context, due[i], deadline);
+      if (grp->wkc > 0)
+      {
+         cyclic->wkc += grp->wkc;
+      }
+   }
+}
+
+/** Cyclic thread, one process data exchange per wakeup until stopped.
+ * @param[in]  param          = cyclic engine
+ */
+static OSAL_THREAD_FUNC_RT ecx_cyclic_thread(void *param)
+{
+   ec_cyclict *cyclic = param;
+   ecx_contextt *context = cyclic->context;
+   ec_groupt *group = &(context->grouplist[cyclic->group]);
+   int64 now, missed;
+
+   while (cyclic->run)
+   {
+      cyclic->wakeup += cyclic->cycletime + cyclic->dcoffset;
+      osal_sleep_until_ns(cyclic->wakeup);
+      cyclic->latency = osal_monotonic_ns() - cyclic->wakeup;
+      if (cyclic->latency > cyclic->maxlatency)
+      {
+         cyclic->maxlatency = cyclic->latency;
+      }
+      if (cyclic->pre)
+      {
+         cyclic->pre(cyclic);
+      }
+      if (cyclic->outimage && ecx_pdimage_take(cyclic->outimage))
+      {
+         memcpy(group->outputs, ecx_pdimage_read(cyclic->outimage),
+                (cyclic->outimage->size < group->Obytes) ? cyclic->outimage->size : group->Obytes);
+      }
+      if (cyclic->multirate)
+      {
+         ecx_cyclic_multirate(cyclic);
+      }
+      else
+      {
+         if (cyclic->use_overlap_io)
+         {
+            ecx_send_overlap_processdata_group(context, cyclic->group);
+         }
+         else
+         {
+            ecx_send_processdata_group(context, cyclic->group);
+         }
+         cyclic->wkc = ecx_receive_processdata_group(context, cyclic->group, cyclic->timeout);
+      }
+      if (cyclic->inimage)
+      {
+         memcpy(ecx_pdimage_write(cyclic->inimage), group->inputs,
+                (cyclic->inimage->size < group->Ibytes) ? cyclic->inimage->size : group->Ibytes);
+         ecx_pdimage_swap(cyclic->inimage);
+      }
+      if (cyclic->post)
+      {
+         cyclic->post(cyclic);
+      }
+      if (cyclic->dclock && group->hasdc)
+      {
+         ecx_cyclic_dcsync(cyclic);
+      }
+      cyclic->cycles++;
+      now = osal_monotonic_ns();
+      missed = (now - cyclic->wakeup) / cyclic->cycletime;
+      if (missed > 0)
+      {
+         cyclic->overruns++;
+         /* continue with the next wakeup still ahead instead of running the
+          * missed cycles back to back */
+         cyclic->wakeup += missed * cyclic->cycletime;
+      }
+   }
+   cyclic->running = FALSE;
+}
+
+/** Set up a cyclic engine with default settings. Does not start it.
+ * @param[in]  context        = context struct
+ * @param[out] cyclic         = cyclic engine
+ * @param[in]  group          = group to exchange
+ * @param[in]  cycletime      = cycle time in ns
+ */
+void ecx_cyclic_init(ecx_contextt *context, ec_cyclict *cyclic, uint8 group, int64 cycletime)
+{
+   memset(cyclic, 0, sizeof(*cyclic));
+   cyclic->context = context;
+   cyclic->group = group;
+   cyclic->cycletime = cycletime;
+   cyclic->timeout = EC_CYCLICTIMEOUT;
+}
+
+/** Start the cyclic thread. The first cycle runs on the next whole multiple
+ * of the cycle time of osal_monotonic_ns().
+ * @param[in]  cyclic         = cyclic engine
+ * @return 1 if started, 0 if already running, cycle time invalid or the
+ * thread could not be created
+ */
+int ecx_cyclic_start(ec_cyclict *cyclic)
+{
+   int64 now;
+
+   if (cyclic->running || (cyclic->cycletime <= 0))
+   {
+      return 0;
+   }
+   cyclic->cycles = 0;
+   cyclic->overruns = 0;
+   cyclic->latency = 0;
+   cyclic->maxlatency = 0;
+   cyclic->dcoffset = 0;
+   cyclic->dcintegral = 0;
+   now = osal_monotonic_ns();
+   cyclic->wakeup = now - (now % cyclic->cycletime);
+   cyclic->run = TRUE;
+   cyclic->running = TRUE;
+   if (!osal_thread_create_rt(&(cyclic->thread), EC_CYCLICSTACK, &ecx_cyclic_thread, cyclic))
+   {
+      cyclic->run = FALSE;
+      cyclic->running = FALSE;
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Stop the cyclic thread and wait until it has finished its last cycle.
+ * @param[in]  cyclic         = cyclic engine
+ */
+void ecx_cyclic_stop(ec_cyclict *cyclic)
+{
+   if (!cyclic->run)
+   {
+      /* not started or already stopped */
+      return;
+   }
+   cyclic->run = FALSE;
+   while (cyclic->running)
+   {
+      osal_usleep(1000);
+   }
+   /* release the thread, each start creates a new one */
+   osal_thread_join(&(cyclic->thread));
+}
+
+#ifdef EC_VER1
+void ec_cyclic_init(ec_cyclict *cyclic, uint8 group, int64 cycletime)
+{
+   ecx_cyclic_init(&ecx_context, cyclic, group, cycletime);
+}
+#endif
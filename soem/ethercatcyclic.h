@@ -0,0 +1,130 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for ethercatcyclic.c
+ */
+
+#ifndef _EC_ECATCYCLIC_H
+#define _EC_ECATCYCLIC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** stack size of the cyclic thread */
+#ifndef EC_CYCLICSTACK
+#define EC_CYCLICSTACK    128000
+#endif
+/** default receive timeout of the cyclic thread in us */
+#define EC_CYCLICTIMEOUT  EC_TIMEOUTRET
+
+/** flag in ec_pdimaget.middle, set when it holds an image not yet read */
+#define EC_PDIMAGE_FRESH  0x04
+/** mask for the buffer index in ec_pdimaget.middle */
+#define EC_PDIMAGE_INDEX  0x03
+
+/** Triple buffered copy of a process image, to pass inputs or outputs
+ * between the cyclic thread and an application thread without locks.
+ * The producer fills its write buffer and commits it, the consumer reads
+ * the newest committed buffer. Only the middle index is shared, it is
+ * exchanged atomically.
+ */
+typedef struct ec_pdimage
+{
+   /** three buffers of size bytes, supplied by the application */
+   uint8          *buf;
+   /** size of one image in bytes */
+   uint32         size;
+   /** internal, buffer owned by the producer */
+   int            back;
+   /** internal, buffer owned by the consumer */
+   int            front;
+   /** internal, buffer in between and EC_PDIMAGE_FRESH */
+   volatile int   middle;
+} ec_pdimaget;
+
+typedef struct ec_cyclic ec_cyclict;
+
+/** Cyclic process data engine of one group, or in multirate mode of all
+ * groups with a divisor at their own rate. Set up with ecx_cyclic_init(),
+ * adjust the configuration fields, then run it with ecx_cyclic_start().
+ * The statistics are written by the cyclic thread only.
+ */
+struct ec_cyclic
+{
+   /** context the engine runs on */
+   ecx_contextt   *context;
+   /** group to exchange, in multirate mode the group the process images and
+    * the DC phase lock refer to */
+   uint8          group;
+   /** TRUE to exchange every group with a divisor set in ec_groupt, each on
+    * its own ticks, instead of only group each cycle */
+   boolean        multirate;
+   /** TRUE if the groups are mapped with ecx_config_overlap_map_group(),
+    * so the overlapping send variants are used */
+   boolean        use_overlap_io;
+   /** cycle time in ns */
+   int64          cycletime;
+   /** receive timeout in us */
+   int            timeout;
+   /** TRUE to phase lock the wakeup to the DC reference clock */
+   boolean        dclock;
+   /** wakeup offset after the DC sync point in ns, used with dclock */
+   int64          dcshift;
+   /** called before the process data is sent, outputs can be set here */
+   void           (*pre)(ec_cyclict *cyclic);
+   /** called after the process data is received, wkc holds the result */
+   void           (*post)(ec_cyclict *cyclic);
+   /** optional, inputs of the group are published here after each receive */
+   ec_pdimaget    *inimage;
+   /** optional, committed outputs are copied to the group before each send */
+   ec_pdimaget    *outimage;
+   /** userdata for the callbacks, not used by SOEM */
+   void           *userdata;
+   /** working counter of the last cycle, in multirate mode the sum of the
+    * groups exchanged, see ec_groupt.wkc for each group */
+   int            wkc;
+   /** number of cycles run */
+   uint64         cycles;
+   /** number of cycles that ran past the next wakeup */
+   uint64         overruns;
+   /** wakeup latency of the last cycle in ns */
+   int64          latency;
+   /** maximum wakeup latency in ns */
+   int64          maxlatency;
+   /** current wakeup correction of the DC phase lock in ns */
+   int64          dcoffset;
+   /** internal, DC phase lock integral */
+   int64          dcintegral;
+   /** internal, next wakeup in ns of osal_monotonic_ns() */
+   int64          wakeup;
+   /** internal, TRUE while the thread should run */
+   volatile int   run;
+   /** internal, TRUE while the thread runs */
+   volatile int   running;
+   /** internal, thread handle */
+   OSAL_THREAD_HANDLE thread;
+};
+
+#ifdef EC_VER1
+void ec_cyclic_init(ec_cyclict *cyclic, uint8 group, int64 cycletime);
+#endif
+
+void ecx_cyclic_init(ecx_contextt *context, ec_cyclict *cyclic, uint8 group, int64 cycletime);
+int ecx_cyclic_start(ec_cyclict *cyclic);
+void ecx_cyclic_stop(ec_cyclict *cyclic);
+void ecx_pdimage_init(ec_pdimaget *image, void *buf, uint32 size);
+uint8 *ecx_pdimage_write(ec_pdimaget *image);
+void ecx_pdimage_commit(ec_pdimaget *image);
+uint8 *ecx_pdimage_read(ec_pdimaget *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EC_ECATCYCLIC_H */
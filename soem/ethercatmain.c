@@ -120,6 +120,9 @@ ecx_contextt  ecx_context = {
     NULL,               // .EOEhook()
     0,                  // .manualstatechange
     NULL,               // .userdata
+    NULL,               // .cache
+    NULL,               // .siicache
+    0,                  // .reusemapping
 };
 #endif
 
@@ -302,7 +305,11 @@ int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char
    ec_etherheadert *ehp;
 
    context->port->redport = redport;
-   ecx_setupnic(context->port, ifname, FALSE);
+   rval = ecx_setupnic(context->port, ifname, FALSE);
+   if (rval <= 0)
+   {
+      return rval;
+   }
    rval = ecx_setupnic(context->port, if2name, TRUE);
    /* prepare "dummy" BRD tx frame for redundant operation */
    ehp = (ec_etherheadert *)&(context->port->txbuf2);
@@ -322,9 +329,233 @@ void ecx_close(ecx_contextt *context)
    ecx_closenic(context->port);
 };
 
+/** Set up an empty SII cache and attach it to the context. Without it,
+ *  also in the default context, SII bytes are only cached for one slave
+ *  at a time in esibuf.
+ *  @param[in]  context  = context struct
+ *  @param[out] siicache = SII cache
+ *  @param[in]  page     = memory for the pages
+ *  @param[in]  maxpage  = number of pages, at most 65535
+ */
+void ecx_siicache_init(ecx_contextt *context, ec_siicachet *siicache, ec_siipaget *page, int maxpage)
+{
+   siicache->page = page;
+   siicache->maxpage = (maxpage < 0xffff) ? maxpage : 0xffff;
+   context->siicache = siicache;
+   ecx_siicache_clear(context);
+}
+
+/** Forget the cached SII bytes of all slaves, does not read any EEPROM.
+ *  The slave cache of ecx_cache_init() is kept.
+ *  @param[in] context = context struct
+ */
+void ecx_siicache_clear(ecx_contextt *context)
+{
+   ec_siicachet *siicache = context->siicache;
+
+   if (siicache)
+   {
+      siicache->npage = 0;
+      siicache->victim = 0;
+      siicache->last = 0;
+      memset(siicache->hash, 0, sizeof(siicache->hash));
+   }
+   if (context->esimap)
+   {
+      memset(context->esimap, 0x00, EC_MAXEEPBITMAP * sizeof(uint32));
+   }
+   context->esislave = 0;
+}
+
+/** Hash bucket of a page in the SII cache */
+#define EC_SIIHASHOF(slave, page) ((((slave) * 31) + (page)) & (EC_SIIHASH - 1))
+
+/** Find the SII cache page of a slave holding an address.
+ *  @param[in] siicache = SII cache
+ *  @param[in] slave    = slave number
+ *  @param[in] page     = eeprom address in bytes divided by EC_SIIPAGESIZE
+ *  @param[in] create   = TRUE to take an empty page if there is none yet,
+ *                        the oldest page is reused when all are taken
+ *  @return page, NULL if not found and not created
+ */
+static ec_siipaget *ecx_siicache_page(ec_siicachet *siicache, uint16 slave, uint16 page, boolean create)
+{
+   ec_siipaget *pg;
+   uint16 *link;
+   int h, i;
+
+   /* SII is mostly read byte after byte */
+   if (siicache->last)
+   {
+      pg = &(siicache->page[siicache->last - 1]);
+      if ((pg->slave == slave) && (pg->page == page))
+      {
+         return pg;
+      }
+   }
+   h = EC_SIIHASHOF(slave, page);
+   for (i = siicache->hash[h]; i; i = siicache->page[i - 1].next)
+   {
+      pg = &(siicache->page[i - 1]);
+      if ((pg->slave == slave) && (pg->page == page))
+      {
+         siicache->last = (uint16)i;
+         return pg;
+      }
+   }
+   if (!create || (siicache->maxpage <= 0))
+   {
+      return NULL;
+   }
+   if (siicache->npage < siicache->maxpage)
+   {
+      i = ++siicache->npage;
+   }
+   else
+   {
+      /* unlink the oldest page from its bucket */
+      i = siicache->victim + 1;
+      siicache->victim = i % siicache->maxpage;
+      pg = &(siicache->page[i - 1]);
+      link = &(siicache->hash[EC_SIIHASHOF(pg->slave, pg->page)]);
+      while (*link != i)
+      {
+         link = &(siicache->page[*link - 1].next);
+      }
+      *link = pg->next;
+   }
+   pg = &(siicache->page[i - 1]);
+   pg->slave = slave;
+   pg->page = page;
+   pg->map = 0;
+   pg->next = siicache->hash[h];
+   siicache->hash[h] = (uint16)i;
+   siicache->last = (uint16)i;
+
+   return pg;
+}
+
+/** Get a byte of slave EEPROM from the cache. The slave cache entry of the
+ *  slave is used if there is one, else the SII cache, else esibuf which
+ *  only holds the slave accessed last.
+ *  @param[in]  context = context struct
+ *  @param[in]  slave   = slave number
+ *  @param[in]  address = eeprom address in bytes, below EC_MAXEEPBUF
+ *  @param[out] data    = byte read
+ *  @return TRUE if the byte was cached
+ */
+static boolean ecx_siicache_get(ecx_contextt *context, uint16 slave, uint16 address, uint8 *data)
+{
+   ec_slavecachet *entry;
+   ec_siipaget *pg;
+   uint16 mapw, mapb;
+
+   entry = ecx_cache_entry(context, slave);
+   if (entry)
+   {
+      return ecx_cache_siiread(entry, address, data, 1);
+   }
+   if (context->siicache)
+   {
+      pg = ecx_siicache_page(context->siicache, slave, address / EC_SIIPAGESIZE, FALSE);
+      mapb = address % EC_SIIPAGESIZE;
+      if (pg && (pg->map & (1U << mapb)))
+      {
+         *data = pg->data[mapb];
+         return TRUE;
+      }
+      return FALSE;
+   }
+   if (slave != context->esislave) /* not the same slave? */
+   {
+      memset(context->esimap, 0x00, EC_MAXEEPBITMAP * sizeof(uint32)); /* clear esibuf cache map */
+      context->esislave = slave;
+   }
+   mapw = address >> 5;
+   mapb = (uint16)(address - (mapw << 5));
+   if (context->esimap[mapw] & (1U << mapb))
+   {
+      *data = context->esibuf[address];
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+/** Put a byte of slave EEPROM read from the slave into the cache that
+ *  ecx_siicache_get() takes it from.
+ *  @param[in] context = context struct
+ *  @param[in] slave   = slave number
+ *  @param[in] address = eeprom address in bytes, ignored if not below EC_MAXEEPBUF
+ *  @param[in] data    = byte read
+ */
+static void ecx_siicache_put(ecx_contextt *context, uint16 slave, uint16 address, uint8 data)
+{
+   ec_slavecachet *entry;
+   ec_siipaget *pg;
+   uint16 mapw, mapb;
+
+   if (address >= EC_MAXEEPBUF)
+   {
+      return;
+   }
+   entry = ecx_cache_entry(context, slave);
+   if (entry)
+   {
+      ecx_cache_siiwrite(entry, address, &data, 1);
+   }
+   else if (context->siicache)
+   {
+      pg = ecx_siicache_page(context->siicache, slave, address / EC_SIIPAGESIZE, TRUE);
+      if (pg)
+      {
+         mapb = address % EC_SIIPAGESIZE;
+         pg->data[mapb] = data;
+         pg->map |= (1U << mapb);
+      }
+   }
+   else if (slave == context->esislave)
+   {
+      mapw = address >> 5;
+      mapb = (uint16)(address - (mapw << 5));
+      context->esibuf[address] = data;
+      context->esimap[mapw] |= (1U << mapb);
+   }
+}
+
+/** Forget the cached EEPROM bytes of one slave.
+ *  @param[in] context = context struct
+ *  @param[in] slave   = slave number
+ */
+static void ecx_siicache_drop(ecx_contextt *context, uint16 slave)
+{
+   ec_siicachet *siicache = context->siicache;
+   int i;
+
+   ecx_cache_invalidate(context, slave);
+   if (siicache)
+   {
+      for (i = 0; i < siicache->npage; i++)
+      {
+         if (siicache->page[i].slave == slave)
+         {
+            siicache->page[i].map = 0;
+         }
+      }
+   }
+   if (context->esislave == slave)
+   {
+      /* cleared on the next access */
+      context->esislave = 0;
+   }
+}
+
 /** Read one byte from slave EEPROM via cache.
  *  If the cache location is empty then a read request is made to the slave.
- *  Depending on the slave capabilities the request is 4 or 8 bytes.
+ *  Depending on the slave capabilities the request is 4 or 8 bytes, all of
+ *  them are put in the cache. With a SII cache set in the context the
+ *  bytes of all slaves are kept, so each is read at most once until
+ *  ecx_siicache_clear() or the cache runs out of pages.
  *  @param[in] context = context struct
  *  @param[in] slave   = slave number
  *  @param[in] address = eeprom address in bytes (slave uses words)
@@ -335,61 +566,38 @@ uint8 ecx_siigetbyte(ecx_contextt *context, uint16 slave, uint16 address)
    uint16 configadr, eadr;
    uint64 edat64;
    uint32 edat32;
-   uint16 mapw, mapb;
+   uint8 edat[8];
    int lp,cnt;
+   boolean ok;
    uint8 retval;
 
    retval = 0xff;
-   if (slave != context->esislave) /* not the same slave? */
-   {
-      memset(context->esimap, 0x00, EC_MAXEEPBITMAP * sizeof(uint32)); /* clear esibuf cache map */
-      context->esislave = slave;
-   }
-   if (address < EC_MAXEEPBUF)
+   if ((address < EC_MAXEEPBUF) && !ecx_siicache_get(context, slave, address, &retval))
    {
-      mapw = address >> 5;
-      mapb = (uint16)(address - (mapw << 5));
-      if (context->esimap[mapw] & (1U << mapb))
+      /* byte is not in cache, put it there */
+      configadr = context->slavelist[slave].configadr;
+      ecx_eeprom2master(context, slave); /* set eeprom control to master */
+      eadr = address >> 1;
+      ok = ecx_readeepromFP_data(context, configadr, eadr, EC_TIMEOUTEEP, &edat64);
+      /* 8 byte response */
+      if (context->slavelist[slave].eep_8byte)
       {
-         /* byte is already in buffer */
-         retval = context->esibuf[address];
+         put_unaligned64(edat64, edat);
+         cnt = 8;
       }
+      /* 4 byte response */
       else
       {
-         /* byte is not in buffer, put it there */
-         configadr = context->slavelist[slave].configadr;
-         ecx_eeprom2master(context, slave); /* set eeprom control to master */
-         eadr = address >> 1;
-         edat64 = ecx_readeepromFP (context, configadr, eadr, EC_TIMEOUTEEP);
-         /* 8 byte response */
-         if (context->slavelist[slave].eep_8byte)
-         {
-            put_unaligned64(edat64, &(context->esibuf[eadr << 1]));
-            cnt = 8;
-         }
-         /* 4 byte response */
-         else
-         {
-            edat32 = (uint32)edat64;
-            put_unaligned32(edat32, &(context->esibuf[eadr << 1]));
-            cnt = 4;
-         }
-         /* find bitmap location */
-         mapw = eadr >> 4;
-         mapb = (uint16)((eadr << 1) - (mapw << 5));
-         for(lp = 0 ; lp < cnt ; lp++)
-         {
-            /* set bitmap for each byte that is read */
-            context->esimap[mapw] |= (1U << mapb);
-            mapb++;
-            if (mapb > 31)
-            {
-               mapb = 0;
-               mapw++;
-            }
-         }
-         retval = context->esibuf[address];
+         edat32 = (uint32)edat64;
+         put_unaligned32(edat32, edat);
+         cnt = 4;
       }
+      /* a failed read is not cached, it is tried again on the next access */
+      for(lp = 0 ; ok && (lp < cnt) ; lp++)
+      {
+         ecx_siicache_put(context, slave, (uint16)((eadr << 1) + lp), edat[lp]);
+      }
+      retval = edat[address - (eadr << 1)];
    }
 
    return retval;
@@ -689,6 +897,10 @@ int ecx_FPRD_multi(ecx_contextt *context, int n, uint16 *configlst, ec_alstatust
 
    port = context->port;
    idx = ecx_getindex(port);
+   if (idx == EC_NOINDEX)
+   {
+      return EC_NOFRAME;
+   }
    slcnt = 0;
    ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx,
       *(configlst + slcnt), ECT_REG_ALSTAT, sizeof(ec_alstatust), slstatlst + slcnt);
@@ -1182,6 +1394,7 @@ int ecx_writeeeprom(ecx_contextt *context, uint16 slave, uint16 eeproma, uint16
 
    ecx_eeprom2master(context, slave); /* set eeprom control to master */
    configadr = context->slavelist[slave].configadr;
+   ecx_siicache_drop(context, slave);
    return (ecx_writeeepromFP(context, configadr, eeproma, data, timeout));
 }
 
@@ -1440,20 +1653,24 @@ uint16 ecx_eeprom_waitnotbusyFP(ecx_contextt *context, uint16 configadr,uint16 *
    return retval;
 }
 
-/** Read EEPROM from slave bypassing cache. FPRD method.
- * @param[in] context     = context struct
- * @param[in] configadr   = configured address of slave
- * @param[in] eeproma     = (WORD) Address in the EEPROM
- * @param[in] timeout     = Timeout in us.
- * @return EEPROM data 64bit or 32bit
+/** Read EEPROM from slave bypassing cache. FPRD method. Unlike
+ * ecx_readeepromFP() a failed read is told apart from data that is 0.
+ * @param[in]  context     = context struct
+ * @param[in]  configadr   = configured address of slave
+ * @param[in]  eeproma     = (WORD) Address in the EEPROM
+ * @param[in]  timeout     = Timeout in us.
+ * @param[out] data        = EEPROM data 64bit or 32bit, 0 if not read
+ * @return TRUE if the data was read
  */
-uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma, int timeout)
+boolean ecx_readeepromFP_data(ecx_contextt *context, uint16 configadr, uint16 eeproma,
+                               int timeout, uint64 *data)
 {
    uint16 estat;
    uint32 edat32;
    uint64 edat64;
    ec_eepromt ed;
    int wkc, cnt, nackcnt = 0;
+   boolean ok = FALSE;
 
    edat64 = 0;
    edat32 = 0;
@@ -1498,6 +1715,7 @@ uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma,
                         wkc=ecx_FPRD(context->port, configadr, ECT_REG_EEPDAT, sizeof(edat64), &edat64, EC_TIMEOUTRET);
                      }
                      while ((wkc <= 0) && (cnt++ < EC_DEFAULTRETRIES));
+                     ok = (wkc > 0);
                   }
                   else
                   {
@@ -1508,6 +1726,7 @@ uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma,
                      }
                      while ((wkc <= 0) && (cnt++ < EC_DEFAULTRETRIES));
                      edat64=(uint64)edat32;
+                     ok = (wkc > 0);
                   }
                }
             }
@@ -1516,6 +1735,24 @@ uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma,
       while ((nackcnt > 0) && (nackcnt < 3));
    }
 
+   *data = edat64;
+
+   return ok;
+}
+
+/** Read EEPROM from slave bypassing cache. FPRD method.
+ * @param[in] context     = context struct
+ * @param[in] configadr   = configured address of slave
+ * @param[in] eeproma     = (WORD) Address in the EEPROM
+ * @param[in] timeout     = Timeout in us.
+ * @return EEPROM data 64bit or 32bit
+ */
+uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma, int timeout)
+{
+   uint64 edat64;
+
+   (void)ecx_readeepromFP_data(context, configadr, eeproma, timeout, &edat64);
+
    return edat64;
 }
 
@@ -1642,236 +1879,632 @@ uint32 ecx_readeeprom2(ecx_contextt *context, uint16 slave, int timeout)
    return edat;
 }
 
-/** Push index of segmented LRD/LWR/LRW combination.
- * @param[in]  context        = context struct
- * @param[in] idx         = Used datagram index.
- * @param[in] data        = Pointer to process data segment.
- * @param[in] length      = Length of data segment in bytes.
- * @param[in] DCO         = Offset position of DC frame.
- */
-static void ecx_pushindex(ecx_contextt *context, uint8 idx, void *data, uint16 length, uint16 DCO)
+/** Read state of a slave in ecx_readeeprom_multi() */
+enum
 {
-   if(context->idxstack->pushed < EC_MAXBUF)
+   /** waiting for the EEPROM interface to be idle */
+   EC_EEPM_IDLE,
+   /** read command to be written */
+   EC_EEPM_CMD,
+   /** read command written, waiting for the data */
+   EC_EEPM_BUSY,
+   /** data read */
+   EC_EEPM_DONE,
+   /** no data, interface stayed busy or did not answer */
+   EC_EEPM_FAIL
+};
+
+/** Read the same EEPROM address of up to EC_MAXEEPMULTI slaves, all slaves
+ * in step. Each round is one command batch for all slaves.
+ * @param[in]  context        = context struct
+ * @param[in]  slaves         = slave numbers
+ * @param[in]  n              = number of slaves, at most EC_MAXEEPMULTI
+ * @param[in]  eeproma        = (WORD) Address in the EEPROM
+ * @param[out] edat           = EEPROM data 32bit per slave, 0 if not read
+ * @param[in]  timeout        = Timeout in us.
+ * @return number of slaves read
+ */
+static int ecx_readeeprom_chunk(ecx_contextt *context, const uint16 *slaves, int n,
+                                uint16 eeproma, uint32 *edat, int timeout)
+{
+   ec_batchcmdt cmds[2 * EC_MAXEEPMULTI];
+   int cmdof[EC_MAXEEPMULTI];
+   uint16 estat[EC_MAXEEPMULTI];
+   uint8 state[EC_MAXEEPMULTI];
+   uint8 tries[EC_MAXEEPMULTI];
+   uint8 cfg[2] = {2, 0};
+   uint16 nop;
+   ec_eepromt ed;
+   ec_slavet *sl;
+   osal_timert timer;
+   int k, nc, pending, rval;
+
+   /* set eeprom control to master, forced from PDI as in ecx_eeprom2master() */
+   nc = 0;
+   for (k = 0; k < n; k++)
+   {
+      sl = &(context->slavelist[slaves[k]]);
+      if (sl->eep_pdi)
+      {
+         ecx_batchcmd(&cmds[nc++], EC_CMD_FPWR, sl->configadr, ECT_REG_EEPCFG, sizeof(cfg[0]), &cfg[0]);
+         ecx_batchcmd(&cmds[nc++], EC_CMD_FPWR, sl->configadr, ECT_REG_EEPCFG, sizeof(cfg[1]), &cfg[1]);
+         sl->eep_pdi = 0;
+      }
+      edat[k] = 0;
+      estat[k] = 0;
+      state[k] = EC_EEPM_IDLE;
+      tries[k] = 0;
+   }
+   if (nc)
+   {
+      ecx_batch(context->port, cmds, nc, EC_TIMEOUTRET3);
+   }
+   nop = htoes(EC_ECMD_NOP);
+   ed.comm = htoes(EC_ECMD_READ);
+   ed.addr = htoes(eeproma);
+   ed.d2   = 0x0000;
+   osal_timer_start(&timer, timeout);
+   do
+   {
+      nc = 0;
+      for (k = 0; k < n; k++)
+      {
+         sl = &(context->slavelist[slaves[k]]);
+         cmdof[k] = nc;
+         switch (state[k])
+         {
+            case EC_EEPM_IDLE:
+               ecx_batchcmd(&cmds[nc++], EC_CMD_FPRD, sl->configadr, ECT_REG_EEPSTAT, sizeof(estat[k]), &estat[k]);
+               break;
+            case EC_EEPM_CMD:
+               if (etohs(estat[k]) & EC_ESTAT_EMASK) /* error bits are set */
+               {
+                  ecx_batchcmd(&cmds[nc++], EC_CMD_FPWR, sl->configadr, ECT_REG_EEPCTL, sizeof(nop), &nop); /* clear error bits */
+               }
+               cmdof[k] = nc;
+               ecx_batchcmd(&cmds[nc++], EC_CMD_FPWR, sl->configadr, ECT_REG_EEPCTL, sizeof(ed), &ed);
+               break;
+            case EC_EEPM_BUSY:
+               /* the data read behind a status that is no longer busy is valid */
+               ecx_batchcmd(&cmds[nc++], EC_CMD_FPRD, sl->configadr, ECT_REG_EEPSTAT, sizeof(estat[k]), &estat[k]);
+               ecx_batchcmd(&cmds[nc++], EC_CMD_FPRD, sl->configadr, ECT_REG_EEPDAT, sizeof(edat[k]), &edat[k]);
+               break;
+            default:
+               break;
+         }
+      }
+      if (!nc)
+      {
+         break;
+      }
+      ecx_batch(context->port, cmds, nc, EC_TIMEOUTRET3);
+      pending = 0;
+      for (k = 0; k < n; k++)
+      {
+         switch (state[k])
+         {
+            case EC_EEPM_IDLE:
+               if ((cmds[cmdof[k]].wkc > 0) && !(etohs(estat[k]) & EC_ESTAT_BUSY))
+               {
+                  state[k] = EC_EEPM_CMD;
+               }
+               else
+               {
+                  pending++;
+               }
+               break;
+            case EC_EEPM_CMD:
+               if (cmds[cmdof[k]].wkc > 0)
+               {
+                  state[k] = EC_EEPM_BUSY;
+               }
+               else if (tries[k]++ >= EC_DEFAULTRETRIES)
+               {
+                  state[k] = EC_EEPM_FAIL;
+               }
+               break;
+            case EC_EEPM_BUSY:
+               if ((cmds[cmdof[k]].wkc > 0) && !(etohs(estat[k]) & EC_ESTAT_BUSY))
+               {
+                  if (etohs(estat[k]) & EC_ESTAT_NACK)
+                  {
+                     /* command not accepted, write it again */
+                     edat[k] = 0;
+                     state[k] = (tries[k]++ < EC_DEFAULTRETRIES) ? EC_EEPM_CMD : EC_EEPM_FAIL;
+                  }
+                  else
+                  {
+                     state[k] = EC_EEPM_DONE;
+                  }
+               }
+               else
+               {
+                  edat[k] = 0;
+                  pending++;
+               }
+               break;
+            default:
+               break;
+         }
+      }
+      /* only wait if an interface was found busy, same as the polls of
+       * ecx_eeprom_waitnotbusyFP() */
+      if (pending)
+      {
+         osal_usleep(EC_LOCALDELAY);
+      }
+   } while (!osal_timer_is_expired(&timer));
+   rval = 0;
+   for (k = 0; k < n; k++)
    {
-      context->idxstack->idx[context->idxstack->pushed] = idx;
-      context->idxstack->data[context->idxstack->pushed] = data;
-      context->idxstack->length[context->idxstack->pushed] = length;
-      context->idxstack->dcoffset[context->idxstack->pushed] = DCO;
-      context->idxstack->pushed++;
+      if (state[k] == EC_EEPM_DONE)
+      {
+         rval++;
+      }
+      else
+      {
+         edat[k] = 0;
+      }
    }
+
+   return rval;
 }
 
-/** Pull index of segmented LRD/LWR/LRW combination.
+/** Read the same EEPROM address of several slaves bypassing cache.
+ * Same result as ecx_readeeprom1() and ecx_readeeprom2() for each slave,
+ * but the slaves are handled in step with their commands packed in shared
+ * frames, so the time does not grow with the number of slaves.
  * @param[in]  context        = context struct
- * @return Stack location, -1 if stack is empty.
+ * @param[in]  slaves         = slave numbers
+ * @param[in]  n              = number of slaves
+ * @param[in]  eeproma        = (WORD) Address in the EEPROM
+ * @param[out] edat           = EEPROM data 32bit per slave, 0 if not read
+ * @param[in]  timeout        = Timeout in us.
+ * @return number of slaves read
  */
-static int ecx_pullindex(ecx_contextt *context)
+int ecx_readeeprom_multi(ecx_contextt *context, const uint16 *slaves, int n,
+                         uint16 eeproma, uint32 *edat, int timeout)
 {
-   int rval = -1;
-   if(context->idxstack->pulled < context->idxstack->pushed)
+   int first, m, rval;
+
+   rval = 0;
+   for (first = 0; first < n; first += m)
    {
-      rval = context->idxstack->pulled;
-      context->idxstack->pulled++;
+      m = n - first;
+      if (m > EC_MAXEEPMULTI)
+      {
+         m = EC_MAXEEPMULTI;
+      }
+      rval += ecx_readeeprom_chunk(context, &slaves[first], m, eeproma, &edat[first], timeout);
    }
 
    return rval;
 }
 
-/** 
- * Clear the idx stack.
- * 
- * @param context           = context struct
- */
-static void ecx_clearindex(ecx_contextt *context)  {
+/** Frame the send functions are packing process data frames into. */
+typedef struct
+{
+   /** head of the open frame, NULL if no frame is open */
+   ec_pdframet *head;
+   /** length of the open frame including ethernet header */
+   uint16 length;
+   /** offset in the open frame of the dlength of its last datagram */
+   uint16 lastdl;
+} ec_pdpackt;
 
-   context->idxstack->pushed = 0;
-   context->idxstack->pulled = 0;
+/** Drop the share of a process data frame in the frame it was sent in. The
+ * frame index is released once no frame packed into it needs it anymore.
+ * @param[in]  context        = context struct
+ * @param[in]  pdframe        = process data frame
+ */
+static void ecx_pdunshare(ecx_contextt *context, const ec_pdframet *pdframe)
+{
+   ec_pdframet *head;
 
+   head = pdframe->owner;
+   /* a head that was sent again on its own no longer counts the old index */
+   if (head->idx == pdframe->idx)
+   {
+      if (head->sharers > 1)
+      {
+         head->sharers--;
+         return;
+      }
+      head->sharers = 0;
+   }
+   ecx_setbufstat(context->port, pdframe->idx, EC_BUF_EMPTY);
 }
 
-/** Transmit processdata to slaves.
+/** Release the frames of a group that were sent and not received.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ */
+static void ecx_pdrelease(ecx_contextt *context, uint8 group)
+{
+   ec_pdtemplatet *tmpl;
+   int i;
+
+   tmpl = &(context->grouplist[group].pdtemplate);
+   for (i = 0; i < tmpl->inflight; i++)
+   {
+      ecx_pdunshare(context, &(tmpl->frame[i]));
+   }
+   tmpl->inflight = 0;
+}
+
+/** Add frame with one process data datagram to a template.
+ * @param[in]  tmpl           = template of group
+ * @param[in]  com            = command, LRW, LRD or LWR
+ * @param[in]  LogAdr         = logical address of datagram
+ * @param[in]  sublength      = length of datagram data
+ * @param[in]  txdata         = data copied into the datagram
+ * @param[in]  rxdata         = where the data of the returned datagram is stored
+ * @param[in]  dc             = TRUE to add the DC datagram to the frame
+ */
+static void ecx_pdframe(ec_pdtemplatet *tmpl, uint8 com, uint32 LogAdr, uint16 sublength,
+                        uint8 *txdata, uint8 *rxdata, boolean dc)
+{
+   ec_pdframet *frame;
+   uint16 txlength;
+
+   frame = &(tmpl->frame[tmpl->nframes++]);
+   txlength = ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE + sublength;
+   frame->header.elength = htoes(EC_ECATTYPE + EC_HEADERSIZE + sublength);
+   frame->header.command = com;
+   frame->header.index = 0;
+   frame->header.ADP = htoes(LO_WORD(LogAdr));
+   frame->header.ADO = htoes(HI_WORD(LogAdr));
+   frame->header.dlength = htoes(sublength);
+   frame->header.irpt = 0;
+   frame->dcoffset = 0;
+   if (dc)
+   {
+      /* FPRMW in second datagram, same layout as ecx_adddatagram() */
+      frame->header.elength = htoes(EC_ECATTYPE + EC_HEADERSIZE + sublength +
+                                    EC_HEADERSIZE + sizeof(int64));
+      frame->header.dlength = htoes(sublength | EC_DATAGRAMFOLLOWS);
+      frame->dcoffset = txlength + EC_HEADERSIZE - EC_ELENGTHSIZE - ETH_HEADERSIZE;
+      txlength += EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE + sizeof(int64);
+   }
+   frame->txlength = txlength;
+   frame->length = sublength;
+   /* read datagrams are sent cleared */
+   frame->txdata = (com == EC_CMD_LRD) ? NULL : txdata;
+   frame->rxdata = rxdata;
+}
+
+/** Compile the process data frames of a group. The datagram headers, the
+ * segmentation and the DC datagram are worked out once, so sending the
+ * process data only has to patch the frame index and copy the outputs.
+ * Called by the IOmap mapping functions, and again by the send functions if
+ * the group layout has changed since, f.e. when DC has been configured.
  * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
- * Both the input and output processdata are transmitted.
- * The outputs with the actual data, the inputs have a placeholder.
- * The inputs are gathered with the receive processdata function.
- * In contrast to the base LRW function this function is non-blocking.
- * If the processdata does not fit in one datagram, multiple are used.
- * In order to recombine the slave response, a stack is used.
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
  * @param[in]  use_overlap_io = flag if overlapped iomap is used
- * @return >0 if processdata is transmitted.
+ * @return number of frames per cycle
  */
-static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+int ecx_compile_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
 {
+   ec_groupt *grp;
+   ec_pdtemplatet *tmpl;
    uint32 LogAdr;
-   uint16 w1, w2;
    int length;
    uint16 sublength;
-   uint8 idx;
-   int wkc;
    uint8* data;
    boolean first=FALSE;
    uint16 currentsegment = 0;
    uint32 iomapinputoffset;
-   uint16 DCO;
 
-   wkc = 0;
-   if(context->grouplist[group].hasdc)
+   ecx_pdrelease(context, group);
+   grp = &(context->grouplist[group]);
+   tmpl = &(grp->pdtemplate);
+   tmpl->outputs = grp->outputs;
+   tmpl->inputs = grp->inputs;
+   tmpl->logstartaddr = grp->logstartaddr;
+   tmpl->Obytes = grp->Obytes;
+   tmpl->Ibytes = grp->Ibytes;
+   tmpl->nsegments = grp->nsegments;
+   tmpl->Isegment = grp->Isegment;
+   tmpl->Ioffset = grp->Ioffset;
+   tmpl->blockLRW = grp->blockLRW;
+   tmpl->dcadr = grp->hasdc ? context->slavelist[grp->DCnext].configadr : 0;
+   tmpl->overlap = use_overlap_io;
+   tmpl->nframes = 0;
+   if(grp->hasdc)
    {
       first = TRUE;
+      tmpl->dcheader.elength = 0;
+      tmpl->dcheader.command = EC_CMD_FRMW;
+      tmpl->dcheader.index = 0;
+      tmpl->dcheader.ADP = htoes(tmpl->dcadr);
+      tmpl->dcheader.ADO = htoes(ECT_REG_DCSYSTIME);
+      tmpl->dcheader.dlength = htoes(sizeof(int64));
+      tmpl->dcheader.irpt = 0;
    }
 
    /* For overlapping IO map use the biggest */
    if(use_overlap_io == TRUE)
    {
       /* For overlap IOmap make the frame EQ big to biggest part */
-      length = (context->grouplist[group].Obytes > context->grouplist[group].Ibytes) ?
-         context->grouplist[group].Obytes : context->grouplist[group].Ibytes;
+      length = (grp->Obytes > grp->Ibytes) ? grp->Obytes : grp->Ibytes;
       /* Save the offset used to compensate where to save inputs when frame returns */
-      iomapinputoffset = context->grouplist[group].Obytes;
+      iomapinputoffset = grp->Obytes;
    }
    else
    {
-      length = context->grouplist[group].Obytes + context->grouplist[group].Ibytes;
+      length = grp->Obytes + grp->Ibytes;
       iomapinputoffset = 0;
    }
-   
-   LogAdr = context->grouplist[group].logstartaddr;
+
+   LogAdr = grp->logstartaddr;
    if(length)
    {
-
-      wkc = 1;
       /* LRW blocked by one or more slaves ? */
-      if(context->grouplist[group].blockLRW)
+      if(grp->blockLRW)
       {
          /* if inputs available generate LRD */
-         if(context->grouplist[group].Ibytes)
+         if(grp->Ibytes)
          {
-            currentsegment = context->grouplist[group].Isegment;
-            data = context->grouplist[group].inputs;
-            length = context->grouplist[group].Ibytes;
-            LogAdr += context->grouplist[group].Obytes;
+            currentsegment = grp->Isegment;
+            data = grp->inputs;
+            length = grp->Ibytes;
+            LogAdr += grp->Obytes;
             /* segment transfer if needed */
             do
             {
-               if(currentsegment == context->grouplist[group].Isegment)
+               if(currentsegment == grp->Isegment)
                {
-                  sublength = (uint16)(context->grouplist[group].IOsegment[currentsegment++] - context->grouplist[group].Ioffset);
+                  sublength = (uint16)(grp->IOsegment[currentsegment++] - grp->Ioffset);
                }
                else
                {
-                  sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
-               }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRD, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
+                  sublength = (uint16)grp->IOsegment[currentsegment++];
                }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
+               ecx_pdframe(tmpl, EC_CMD_LRD, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
          /* if outputs available generate LWR */
-         if(context->grouplist[group].Obytes)
+         if(grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
-            length = context->grouplist[group].Obytes;
-            LogAdr = context->grouplist[group].logstartaddr;
+            data = grp->outputs;
+            length = grp->Obytes;
+            LogAdr = grp->logstartaddr;
             currentsegment = 0;
             /* segment transfer if needed */
             do
             {
-               sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
+               sublength = (uint16)grp->IOsegment[currentsegment++];
                if((length - sublength) < 0)
                {
                   sublength = (uint16)length;
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LWR, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
-               }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
+               ecx_pdframe(tmpl, EC_CMD_LWR, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
       }
       /* LRW can be used */
       else
       {
-         if (context->grouplist[group].Obytes)
+         if (grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
+            data = grp->outputs;
          }
          else
          {
-            data = context->grouplist[group].inputs;
+            data = grp->inputs;
             /* Clear offset, don't compensate for overlapping IOmap if we only got inputs */
             iomapinputoffset = 0;
          }
          /* segment transfer if needed */
          do
          {
-            sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
-            /* get new index */
-            idx = ecx_getindex(context->port);
-            w1 = LO_WORD(LogAdr);
-            w2 = HI_WORD(LogAdr);
-            DCO = 0;
-            ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRW, idx, w1, w2, sublength, data);
-            if(first)
-            {
-               /* FPRMW in second datagram */
-               DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                        context->slavelist[context->grouplist[group].DCnext].configadr,
-                                        ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-               first = FALSE;
-            }
-            /* send frame */
-            ecx_outframe_red(context->port, idx);
-            /* push index and data pointer on stack.
-             * the iomapinputoffset compensate for where the inputs are stored 
+            sublength = (uint16)grp->IOsegment[currentsegment++];
+            /* the iomapinputoffset compensate for where the inputs are stored
              * in the IOmap if we use an overlapping IOmap. If a regular IOmap
              * is used it should always be 0.
              */
-            ecx_pushindex(context, idx, (data + iomapinputoffset), sublength, DCO);      
+            ecx_pdframe(tmpl, EC_CMD_LRW, LogAdr, sublength, data, data + iomapinputoffset, first);
+            first = FALSE;
             length -= sublength;
             LogAdr += sublength;
             data += sublength;
-         } while (length && (currentsegment < context->grouplist[group].nsegments));
+         } while (length && (currentsegment < grp->nsegments));
       }
    }
 
-   return wkc;
+   return tmpl->nframes;
+}
+
+/** Check if the compiled frames of a group still match its layout.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return TRUE if the frames can be used
+ */
+static boolean ecx_pdtemplate_valid(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+{
+   const ec_groupt *grp = &(context->grouplist[group]);
+   const ec_pdtemplatet *tmpl = &(grp->pdtemplate);
+
+   return (tmpl->overlap == use_overlap_io) &&
+          (tmpl->outputs == grp->outputs) &&
+          (tmpl->inputs == grp->inputs) &&
+          (tmpl->logstartaddr == grp->logstartaddr) &&
+          (tmpl->Obytes == grp->Obytes) &&
+          (tmpl->Ibytes == grp->Ibytes) &&
+          (tmpl->nsegments == grp->nsegments) &&
+          (tmpl->Isegment == grp->Isegment) &&
+          (tmpl->Ioffset == grp->Ioffset) &&
+          (tmpl->blockLRW == grp->blockLRW) &&
+          (tmpl->dcadr == (grp->hasdc ? context->slavelist[grp->DCnext].configadr : 0));
+}
+
+/** Write the datagrams of a process data frame into a tx buffer, from the
+ * command of the first datagram on. The ethertype length field is left to
+ * the caller.
+ * @param[in]  context        = context struct
+ * @param[in]  tmpl           = template of group
+ * @param[in]  pdframe        = process data frame
+ * @param[out] frameP         = tx buffer
+ * @param[in]  pos            = offset in tx buffer of the first command
+ * @param[in]  idx            = frame index
+ * @return offset in tx buffer of the dlength of the last datagram written
+ */
+static uint16 ecx_pdwrite(ecx_contextt *context, const ec_pdtemplatet *tmpl,
+                          const ec_pdframet *pdframe, uint8 *frameP, uint16 pos, uint8 idx)
+{
+   ec_comt *datagramP;
+   uint16 lastdl;
+
+   datagramP = (ec_comt *)&frameP[pos - EC_ELENGTHSIZE];
+   memcpy(&(datagramP->command), &(pdframe->header.command), EC_HEADERSIZE - EC_ELENGTHSIZE);
+   datagramP->index = idx;
+   lastdl = (uint16)((uint8 *)&(datagramP->dlength) - frameP);
+   pos += EC_HEADERSIZE - EC_ELENGTHSIZE;
+   if (pdframe->txdata)
+   {
+      memcpy(&frameP[pos], pdframe->txdata, pdframe->length);
+   }
+   else
+   {
+      memset(&frameP[pos], 0, pdframe->length);
+   }
+   pos += pdframe->length;
+   /* set WKC to zero */
+   frameP[pos++] = 0x00;
+   frameP[pos++] = 0x00;
+   if (pdframe->dcoffset)
+   {
+      /* DC datagram header follows the WKC, it has no ethertype length */
+      datagramP = (ec_comt *)&frameP[pos - EC_ELENGTHSIZE];
+      memcpy(&(datagramP->command), &(tmpl->dcheader.command), EC_HEADERSIZE - EC_ELENGTHSIZE);
+      datagramP->index = idx;
+      lastdl = (uint16)((uint8 *)&(datagramP->dlength) - frameP);
+      pos += EC_HEADERSIZE - EC_ELENGTHSIZE;
+      memcpy(&frameP[pos], context->DCtime, sizeof(int64));
+      pos += sizeof(int64);
+      frameP[pos++] = 0x00;
+      frameP[pos++] = 0x00;
+   }
+
+   return lastdl;
+}
+
+/** Queue the open frame of a pack, sent by ecx_flushframes().
+ * @param[in]  context        = context struct
+ * @param[in]  pack           = frame being packed
+ */
+static void ecx_pdclose(ecx_contextt *context, ec_pdpackt *pack)
+{
+   if (pack->head)
+   {
+      ecx_queueframe_red(context->port, pack->head->idx);
+      pack->head = NULL;
+   }
+}
+
+/** Queue processdata frames for transmission to slaves.
+ * Both the input and output processdata are transmitted.
+ * The outputs with the actual data, the inputs have a placeholder.
+ * The inputs are gathered with the receive processdata function.
+ * In contrast to the base LRW function this function is non-blocking.
+ * If the processdata does not fit in one datagram, multiple are used.
+ * In order to recombine the slave response, a stack is used.
+ * The frames are taken from the template made by ecx_compile_processdata().
+ * The frame indexes are kept with the group, so the frames of several groups
+ * can be in flight and received in any order. Frames of the group still in
+ * flight from a previous call are given up.
+ * Small frames are packed behind each other into one ethernet frame up to
+ * EC_MAXPDFRAME, also across groups sent with the same pack. The frames are
+ * only queued, the caller closes the pack with ecx_pdclose() and transmits
+ * them all at once with ecx_flushframes().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @param[in]  pack           = frame being packed
+ * @return >0 if processdata is transmitted.
+ */
+static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io,
+                                     ec_pdpackt *pack)
+{
+   ec_pdtemplatet *tmpl;
+   ec_pdframet *pdframe;
+   ec_pdframet *head;
+   uint8 *frameP;
+   uint16 datagrams, le_dlength;
+   uint8 idx;
+   int i;
+
+   tmpl = &(context->grouplist[group].pdtemplate);
+   ecx_pdrelease(context, group);
+   if (!ecx_pdtemplate_valid(context, group, use_overlap_io))
+   {
+      ecx_compile_processdata(context, group, use_overlap_io);
+   }
+   for (i = 0; i < tmpl->nframes; i++)
+   {
+      pdframe = &(tmpl->frame[i]);
+      /* length of the datagrams, without ethernet header and length field */
+      datagrams = pdframe->txlength - ETH_HEADERSIZE - EC_ELENGTHSIZE;
+      head = pack->head;
+      if (head && ((pack->length + datagrams) <= EC_MAXPDFRAME))
+      {
+         /* chain the datagrams behind the last one in the open frame */
+         idx = head->idx;
+         frameP = context->port->txbuf[idx];
+         memcpy(&le_dlength, &frameP[pack->lastdl], sizeof(le_dlength));
+         le_dlength = htoes(etohs(le_dlength) | EC_DATAGRAMFOLLOWS);
+         memcpy(&frameP[pack->lastdl], &le_dlength, sizeof(le_dlength));
+         pdframe->rxoffset = pack->length - ETH_HEADERSIZE - EC_ELENGTHSIZE;
+         pack->lastdl = ecx_pdwrite(context, tmpl, pdframe, frameP, pack->length, idx);
+         pack->length += datagrams;
+         ((ec_comt *)&frameP[ETH_HEADERSIZE])->elength =
+            htoes(EC_ECATTYPE + pack->length - ETH_HEADERSIZE - EC_ELENGTHSIZE);
+         context->port->txbuflength[idx] = pack->length;
+         /* the driver only places the first datagram of a frame */
+         pdframe->placed = FALSE;
+         head->sharers++;
+      }
+      else
+      {
+         ecx_pdclose(context, pack);
+         /* get new index, frames without one are not sent this cycle */
+         idx = ecx_getindex(context->port);
+         if (idx == EC_NOINDEX)
+         {
+            break;
+         }
+         frameP = context->port->txbuf[idx];
+         ((ec_comt *)&frameP[ETH_HEADERSIZE])->elength = pdframe->header.elength;
+         pdframe->rxoffset = 0;
+         pack->lastdl = ecx_pdwrite(context, tmpl, pdframe, frameP,
+                                    ETH_HEADERSIZE + EC_ELENGTHSIZE, idx);
+         pack->length = pdframe->txlength;
+         context->port->txbuflength[idx] = pdframe->txlength;
+         /* let the driver put returned inputs straight into the IOmap if it can */
+         pdframe->placed = (pdframe->header.command != EC_CMD_LWR) &&
+                           !context->grouplist[group].trackchanges &&
+                           ecx_setrxplace(context->port, idx, pdframe->rxdata, pdframe->length);
+         pdframe->sharers = 1;
+         pdframe->rxdone = FALSE;
+         head = pdframe;
+         pack->head = head;
+      }
+      pdframe->owner = head;
+      pdframe->idx = idx;
+      tmpl->inflight++;
+   }
+
+   return (tmpl->inflight > 0);
 }
 
 /** Transmit processdata to slaves.
@@ -1888,7 +2521,15 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
 */
 int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group)
 {
-   return ecx_main_send_processdata(context, group, TRUE);
+   ec_pdpackt pack;
+   int wkc;
+
+   pack.head = NULL;
+   wkc = ecx_main_send_processdata(context, group, TRUE, &pack);
+   ecx_pdclose(context, &pack);
+   ecx_flushframes(context->port);
+
+   return wkc;
 }
 
 /** Transmit processdata to slaves.
@@ -1905,96 +2546,380 @@ int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group)
 */
 int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
 {
-   return ecx_main_send_processdata(context, group, FALSE);
+   ec_pdpackt pack;
+   int wkc;
+
+   pack.head = NULL;
+   wkc = ecx_main_send_processdata(context, group, FALSE, &pack);
+   ecx_pdclose(context, &pack);
+   ecx_flushframes(context->port);
+
+   return wkc;
 }
 
-/** Receive processdata from slaves.
- * Second part from ec_send_processdata().
- * Received datagrams are recombined with the processdata with help from the stack.
- * If a datagram contains input processdata it copies it to the processdata structure.
+/** Transmit processdata of several groups to slaves.
+ * Same as ecx_send_processdata_group() for each group, but the frames of all
+ * groups are put on the wire back-to-back in one burst. Small groups are
+ * packed into shared frames, so groups sent together have to be received
+ * from the same thread and should all be received before any of them is
+ * sent again.
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = list of group numbers
+ * @param[in]  ngroups        = number of groups in list
+ * @return >0 if processdata of any group is transmitted.
+ */
+int ecx_send_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups)
+{
+   ec_pdpackt pack;
+   int i, wkc;
+
+   /* release all groups first, their old frames may be packed together */
+   for (i = 0; i < ngroups; i++)
+   {
+      ecx_pdrelease(context, groups[i]);
+   }
+   pack.head = NULL;
+   wkc = 0;
+   for (i = 0; i < ngroups; i++)
+   {
+      if (ecx_main_send_processdata(context, groups[i], FALSE, &pack) > 0)
+      {
+         wkc = 1;
+      }
+   }
+   ecx_pdclose(context, &pack);
+   ecx_flushframes(context->port);
+
+   return wkc;
+}
+
+/** Transmit processdata of several groups to slaves, overlapped IOmap variant.
+ * @see ecx_send_processdata_groups
+ * @param[in]  context        = context struct
+ * @param[in]  groups         = list of group numbers
+ * @param[in]  ngroups        = number of groups in list
+ * @return >0 if processdata of any group is transmitted.
+ */
+int ecx_send_overlap_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups)
+{
+   ec_pdpackt pack;
+   int i, wkc;
+
+   /* release all groups first, their old frames may be packed together */
+   for (i = 0; i < ngroups; i++)
+   {
+      ecx_pdrelease(context, groups[i]);
+   }
+   pack.head = NULL;
+   wkc = 0;
+   for (i = 0; i < ngroups; i++)
+   {
+      if (ecx_main_send_processdata(context, groups[i], TRUE, &pack) > 0)
+      {
+         wkc = 1;
+      }
+   }
+   ecx_pdclose(context, &pack);
+   ecx_flushframes(context->port);
+
+   return wkc;
+}
+
+/** Time left until a deadline.
+ * @param[in]  deadline       = absolute time in ns as from osal_monotonic_ns()
+ * @return time left in us, 0 if the deadline has passed
+ */
+static int ecx_timeleft(const int64 *deadline)
+{
+   int64 left;
+
+   left = *deadline - osal_monotonic_ns();
+   if (left <= 0)
+   {
+      return 0;
+   }
+   left = (left + 999) / 1000;
+   if (left >= INT32_MAX)
+   {
+      return INT32_MAX;
+   }
+
+   return (int)left;
+}
+
+/** Copy returned datagram data to the IOmap. Where it covers the group
+ * inputs it is compared line by line first, only changed lines are copied
+ * and marked in the changed bitmap of the group.
+ * @param[in]  grp            = group
+ * @param[out] dst            = IOmap destination of datagram data
+ * @param[in]  src            = datagram data in rx buffer
+ * @param[in]  length         = length of datagram data
+ */
+static void ecx_copychanged(ec_groupt *grp, uint8 *dst, const uint8 *src, int length)
+{
+   int pos, line, n;
+
+   /* part before the inputs, outputs of a non overlapped LRW */
+   if (dst < grp->inputs)
+   {
+      n = (int)(grp->inputs - dst);
+      n = (n < length) ? n : length;
+      memcpy(dst, src, n);
+      dst += n;
+      src += n;
+      length -= n;
+   }
+   pos = (int)(dst - grp->inputs);
+   while ((length > 0) && ((uint32)pos < grp->Ibytes) && (pos < EC_MAXCHANGELINES * EC_CHANGELINE))
+   {
+      line = pos / EC_CHANGELINE;
+      n = ((line + 1) * EC_CHANGELINE) - pos;
+      n = (n < length) ? n : length;
+      if (memcmp(dst, src, n))
+      {
+         memcpy(dst, src, n);
+         grp->changed[line / 32] |= (uint32)1 << (line % 32);
+      }
+      dst += n;
+      src += n;
+      pos += n;
+      length -= n;
+   }
+   if (length > 0)
+   {
+      memcpy(dst, src, length);
+   }
+}
+
+/** Check the changed bitmap of a group for the input lines of a slave.
+ * @param[in]  grp            = group the slave inputs are mapped in
+ * @param[in]  sl             = slave
+ * @return TRUE if one of the lines changed
+ */
+static boolean ecx_slavechanged(const ec_groupt *grp, const ec_slavet *sl)
+{
+   int first, last, line;
+   uint32 len;
+
+   len = sl->Ibytes ? sl->Ibytes : (sl->Ibits ? 1 : 0);
+   if (!grp->trackchanges || !len || (sl->inputs < grp->inputs))
+   {
+      return FALSE;
+   }
+   first = (int)(sl->inputs - grp->inputs) / EC_CHANGELINE;
+   last = (int)(sl->inputs + len - 1 - grp->inputs) / EC_CHANGELINE;
+   for (line = first; (line <= last) && (line < EC_MAXCHANGELINES); line++)
+   {
+      if (grp->changed[line / 32] & ((uint32)1 << (line % 32)))
+      {
+         return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+/** Call the change hook of a group for every slave with changed inputs.
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
- * @param[in]  timeout        = Timeout in us.
+ */
+static void ecx_changehooks(ecx_contextt *context, uint8 group)
+{
+   ec_groupt *grp = &(context->grouplist[group]);
+   uint16 slave;
+   uint32 any;
+   int i;
+
+   any = 0;
+   for (i = 0; i < (int)(sizeof(grp->changed) / sizeof(grp->changed[0])); i++)
+   {
+      any |= grp->changed[i];
+   }
+   if (!any)
+   {
+      return;
+   }
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      if ((!group || (context->slavelist[slave].group == group)) &&
+          ecx_slavechanged(grp, &(context->slavelist[slave])))
+      {
+         grp->changehook(context, slave);
+      }
+   }
+}
+
+/** Receive processdata from slaves, common part of the timeout and deadline
+ * variants.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  timeout        = Timeout in us for each frame, if no deadline
+ * @param[in]  deadline       = absolute time all frames must be in by, or NULL
  * @return Work counter.
  */
-int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
+static int ecx_main_receive_processdata(ecx_contextt *context, uint8 group, int timeout,
+                                        const int64 *deadline)
 {
    uint8 idx;
-   int pos;
+   int i;
    int wkc = 0, wkc2;
    uint16 le_wkc = 0;
    int valid_wkc = 0;
    int64 le_DCtime;
-   ec_idxstackT *idxstack;
-   ec_bufT *rxbuf;
-
-   /* just to prevent compiler warning for unused group */
-   wkc2 = group;
-
-   idxstack = context->idxstack;
-   rxbuf = context->port->rxbuf;
-   /* get first index */
-   pos = ecx_pullindex(context);
+   ec_groupt *grp;
+   ec_pdtemplatet *tmpl;
+   const ec_pdframet *pdframe;
+   ec_pdframet *head;
+   uint8 *rxbuf;
+
+   grp = &(context->grouplist[group]);
+   tmpl = &(grp->pdtemplate);
+   memset(tmpl->rxmask, 0, sizeof(tmpl->rxmask));
+   if (grp->trackchanges)
+   {
+      memset(grp->changed, 0, sizeof(grp->changed));
+   }
    /* read the same number of frames as send */
-   while (pos >= 0)
+   for (i = 0; i < tmpl->inflight; i++)
    {
-      idx = idxstack->idx[pos];
-      wkc2 = ecx_waitinframe(context->port, idx, timeout);
+      pdframe = &(tmpl->frame[i]);
+      head = pdframe->owner;
+      idx = pdframe->idx;
+      if (deadline)
+      {
+         /* once the deadline has passed frames already in are still taken */
+         timeout = ecx_timeleft(deadline);
+      }
+      /* the receive state of the head belongs to the index it was sent with
+       * last, if it was sent again on its own the old index is waited for
+       * directly, a frame already received is returned at once */
+      if (head->idx != idx)
+      {
+         wkc2 = ecx_waitinframe(context->port, idx, timeout);
+      }
+      else
+      {
+         /* a frame packed with others is waited for by the first to take it */
+         if (!head->rxdone)
+         {
+            head->rxwkc = ecx_waitinframe(context->port, idx, timeout);
+            head->rxdone = TRUE;
+         }
+         wkc2 = head->rxwkc;
+      }
+      /* rx buffer of index is only valid once the frame is received, the
+       * datagrams of the frame are shifted by rxoffset if packed */
+      rxbuf = &(context->port->rxbuf[idx][pdframe->rxoffset]);
       /* check if there is input data in frame */
       if (wkc2 > EC_NOFRAME)
       {
-         if((rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD) || (rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRW))
+         tmpl->rxmask[i / 32] |= (uint32)1 << (i % 32);
+         /* WKC of the datagram itself, the frame WKC is that of the last one */
+         memcpy(&le_wkc, &(rxbuf[EC_HEADERSIZE + pdframe->length]), EC_WKCSIZE);
+         if((rxbuf[EC_CMDOFFSET]==EC_CMD_LRD) || (rxbuf[EC_CMDOFFSET]==EC_CMD_LRW))
          {
-            if(idxstack->dcoffset[pos] > 0)
+            if (grp->trackchanges)
+            {
+               ecx_copychanged(grp, pdframe->rxdata, &(rxbuf[EC_HEADERSIZE]), pdframe->length);
+            }
+            else if (!pdframe->placed)
+            {
+               /* copy input data back to process data buffer */
+               memcpy(pdframe->rxdata, &(rxbuf[EC_HEADERSIZE]), pdframe->length);
+            }
+            if(pdframe->dcoffset > 0)
             {
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
                wkc = etohs(le_wkc);
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
+               memcpy(&le_DCtime, &(rxbuf[pdframe->dcoffset]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
             }
             else
             {
-               /* copy input data back to process data buffer */
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
-               wkc += wkc2;
+               wkc += etohs(le_wkc);
             }
             valid_wkc = 1;
          }
-         else if(rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LWR)
+         else if(rxbuf[EC_CMDOFFSET]==EC_CMD_LWR)
          {
-            if(idxstack->dcoffset[pos] > 0)
+            if(pdframe->dcoffset > 0)
             {
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
                /* output WKC counts 2 times when using LRW, emulate the same for LWR */
                wkc = etohs(le_wkc) * 2;
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
+               memcpy(&le_DCtime, &(rxbuf[pdframe->dcoffset]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
             }
             else
             {
                /* output WKC counts 2 times when using LRW, emulate the same for LWR */
-               wkc += wkc2 * 2;
+               wkc += etohs(le_wkc) * 2;
             }
             valid_wkc = 1;
          }
       }
-      /* release buffer */
-      ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
-      /* get next index */
-      pos = ecx_pullindex(context);
+      /* release buffer once all frames packed into it are taken */
+      ecx_pdunshare(context, pdframe);
    }
-
-   ecx_clearindex(context);
+   tmpl->inflight = 0;
 
    /* if no frames has arrived */
    if (valid_wkc == 0)
    {
       return EC_NOFRAME;
    }
+   if (grp->trackchanges && grp->changehook)
+   {
+      ecx_changehooks(context, group);
+   }
    return wkc;
 }
 
+/** Receive processdata from slaves.
+ * Second part from ec_send_processdata().
+ * Received datagrams are recombined with the processdata with help from the
+ * frame indexes kept with the group, frames of other groups are left alone.
+ * If a datagram contains input processdata it copies it to the processdata structure.
+ * Each frame is waited for up to timeout. Which frames were received is
+ * left in the rxmask of the group template.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  timeout        = Timeout in us.
+ * @return Work counter.
+ */
+int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
+{
+   return ecx_main_receive_processdata(context, group, timeout, NULL);
+}
+
+/** Receive processdata from slaves before a deadline.
+ * Same as ecx_receive_processdata_group(), but all frames of the group share
+ * one absolute deadline, so lost frames can not add up to several timeouts.
+ * When the deadline passes the frames received so far are used and the rest
+ * is given up. Bit n of the rxmask of the group template is set if frame n
+ * was received, the work counter only counts received frames.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  deadline       = absolute time in ns as from osal_monotonic_ns()
+ * @return Work counter, EC_NOFRAME if no frame was received.
+ */
+int ecx_receive_processdata_group_deadline(ecx_contextt *context, uint8 group, int64 deadline)
+{
+   return ecx_main_receive_processdata(context, group, 0, &deadline);
+}
+
+/** Check if the inputs of a slave changed in the last receive of its group.
+ * Only available for groups with trackchanges set, the check is on the
+ * EC_CHANGELINE sized lines the slave inputs touch, so a change of a
+ * neighbouring slave in the same line also counts.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @return TRUE if changed
+ */
+boolean ecx_inputs_changed(ecx_contextt *context, uint16 slave)
+{
+   ec_slavet *sl = &(context->slavelist[slave]);
+
+   return ecx_slavechanged(&(context->grouplist[sl->group]), sl);
+}
 
 int ecx_send_processdata(ecx_contextt *context)
 {
@@ -2350,6 +3275,20 @@ uint32 ec_readeeprom2(uint16 slave, int timeout)
    return ecx_readeeprom2 (&ecx_context, slave, timeout);
 }
 
+/** Read the same EEPROM address of several slaves bypassing cache.
+ * @param[in]  slaves      = slave numbers
+ * @param[in]  n           = number of slaves
+ * @param[in]  eeproma     = (WORD) Address in the EEPROM
+ * @param[out] edat        = EEPROM data 32bit per slave, 0 if not read
+ * @param[in]  timeout     = Timeout in us.
+ * @return number of slaves read
+ * @see ecx_readeeprom_multi
+ */
+int ec_readeeprom_multi(const uint16 *slaves, int n, uint16 eeproma, uint32 *edat, int timeout)
+{
+   return ecx_readeeprom_multi(&ecx_context, slaves, n, eeproma, edat, timeout);
+}
+
 /** Transmit processdata to slaves.
  * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
  * Both the input and output processdata are transmitted.
@@ -2398,6 +3337,27 @@ int ec_receive_processdata_group(uint8 group, int timeout)
    return ecx_receive_processdata_group (&ecx_context, group, timeout);
 }
 
+/** Receive processdata from slaves before a deadline.
+ * @param[in]  group          = group number
+ * @param[in]  deadline       = absolute time in ns as from osal_monotonic_ns()
+ * @return Work counter.
+ * @see ecx_receive_processdata_group_deadline
+ */
+int ec_receive_processdata_group_deadline(uint8 group, int64 deadline)
+{
+   return ecx_receive_processdata_group_deadline(&ecx_context, group, deadline);
+}
+
+/** Check if the inputs of a slave changed in the last receive.
+ * @param[in]  slave          = slave number
+ * @return TRUE if changed
+ * @see ecx_inputs_changed
+ */
+boolean ec_inputs_changed(uint16 slave)
+{
+   return ecx_inputs_changed(&ecx_context, slave);
+}
+
 int ec_send_processdata(void)
 {
    return ec_send_processdata_group(0);
@@ -23,14 +23,35 @@ extern "C"
 #define EC_MAXNAME        40
 /** max. number of slaves in array */
 #define EC_MAXSLAVE       200
-/** max. number of groups */
+/** max. number of groups in the default context, an own context can hand
+ * any number of groups up to 256 in its grouplist and maxgroup */
+#ifndef EC_MAXGROUP
 #define EC_MAXGROUP       2
+#endif
 /** max. number of IO segments per group */
 #define EC_MAXIOSEGMENTS  64
+/** max. length of a frame with packed process data, ethernet header
+ * included and FCS excluded */
+#define EC_MAXPDFRAME     (EC_MAXECATFRAME - 4)
+/** size in bytes of the input lines tracked for changes */
+#define EC_CHANGELINE     64
+/** max. number of input lines tracked for changes per group */
+#define EC_MAXCHANGELINES ((EC_MAXIOSEGMENTS * EC_MAXLRWDATA + EC_CHANGELINE - 1) / EC_CHANGELINE)
 /** max. mailbox size */
 #define EC_MAXMBX         1486
 /** max. eeprom PDO entries */
 #define EC_MAXEEPDO       0x200
+/** max. slaves read in step by ecx_readeeprom_multi() */
+#define EC_MAXEEPMULTI    32
+/** bytes in one page of the SII cache */
+#define EC_SIIPAGESIZE    32
+/** number of hash buckets of the SII cache */
+#define EC_SIIHASH        256
+/** suggested number of pages for ecx_siicache_init(), when all are taken
+ * the oldest page is reused */
+#ifndef EC_MAXSIIPAGE
+#define EC_MAXSIIPAGE     1024
+#endif
 /** max. SM used */
 #define EC_MAXSM          8
 /** max. FMMU used */
@@ -101,6 +122,7 @@ PACKED_END
 #define EC_SMENABLEMASK      0xfffeffff
 
 typedef struct ecx_context ecx_contextt;
+typedef struct ec_cache ec_cachet;
 
 /** for list of ethercat slaves detected */
 typedef struct ec_slave
@@ -121,6 +143,9 @@ typedef struct ec_slave
    uint32           eep_rev;
    /** serial number from EEprom */
    uint32           eep_sn;
+   /** first slave with the same manufacturer, ID and revision, 0 if none
+    * before this one, set by ecx_config_init() */
+   uint16           idfirst;
    /** Interface type */
    uint16           Itype;
    /** Device type */
@@ -237,6 +262,66 @@ typedef struct ec_slave
    char             name[EC_MAXNAME + 1];
 } ec_slavet;
 
+/** precompiled process data frame of a group */
+typedef struct ec_pdframe
+{
+   /** EtherCAT header of the datagram as sent, index patched in each cycle */
+   ec_comt          header;
+   /** frame length including ethernet header */
+   uint16           txlength;
+   /** length of datagram data */
+   uint16           length;
+   /** offset of DC datagram data in rx frame, 0 if frame has no DC datagram */
+   uint16           dcoffset;
+   /** data copied into the datagram, NULL if the datagram is cleared */
+   uint8            *txdata;
+   /** where the data of the returned datagram is stored */
+   uint8            *rxdata;
+   /** frame index the frame was sent with */
+   uint8            idx;
+   /** TRUE if the driver puts the returned data at rxdata itself */
+   boolean          placed;
+   /** offset of the datagrams in the frame sent, >0 if packed behind others */
+   uint16           rxoffset;
+   /** frame this one is packed into, itself if it heads its own frame */
+   struct ec_pdframe *owner;
+   /** head only, number of packed frames that have not released the index */
+   uint8            sharers;
+   /** head only, TRUE once the frame has been waited for */
+   boolean          rxdone;
+   /** head only, result of waiting for the frame */
+   int              rxwkc;
+} ec_pdframet;
+
+/** process data frames of a group, compiled from the group layout */
+typedef struct ec_pdtemplate
+{
+   /** group layout the frames are compiled from, recompiled if it changed */
+   uint8            *outputs;
+   uint8            *inputs;
+   uint32           logstartaddr;
+   uint32           Obytes;
+   uint32           Ibytes;
+   uint16           nsegments;
+   uint16           Isegment;
+   uint16           Ioffset;
+   uint8            blockLRW;
+   /** configured address of DC slave, 0 if group has no DC */
+   uint16           dcadr;
+   /** TRUE if compiled for overlapping IOmap */
+   boolean          overlap;
+   /** header of the DC datagram, the ethertype length field is not used */
+   ec_comt          dcheader;
+   /** number of frames */
+   uint16           nframes;
+   /** number of frames sent and not yet received */
+   uint16           inflight;
+   /** frames of the last receive, bit n set if frame n was received */
+   uint32           rxmask[(2 * EC_MAXIOSEGMENTS + 31) / 32];
+   /** frames, LRD and LWR when LRW is blocked */
+   ec_pdframet      frame[2 * EC_MAXIOSEGMENTS];
+} ec_pdtemplatet;
+
 /** for list of ethercat slave groups */
 typedef struct ec_group
 {
@@ -272,6 +357,23 @@ typedef struct ec_group
    boolean          docheckstate;
    /** IO segmentation list. Datagrams must not break SM in two. */
    uint32           IOsegment[EC_MAXIOSEGMENTS];
+   /** precompiled process data frames */
+   ec_pdtemplatet   pdtemplate;
+   /** TRUE to track which inputs change on receive */
+   boolean          trackchanges;
+   /** bit n set if input bytes n * EC_CHANGELINE up to the next line changed
+    * in the last receive, counted from the group inputs */
+   uint32           changed[(EC_MAXCHANGELINES + 31) / 32];
+   /** called after receive for each slave of the group with changed inputs */
+   void             (*changehook)(ecx_contextt *context, uint16 slave);
+   /** multirate cyclic engine, exchange the group every divisor-th tick,
+    * 0 to leave it out */
+   uint16           divisor;
+   /** multirate cyclic engine, tick within the divisor the group is
+    * exchanged on, to spread slow groups over the ticks */
+   uint16           phase;
+   /** multirate cyclic engine, working counter of the last exchange */
+   int              wkc;
 } ec_groupt;
 
 /** SII FMMU structure */
@@ -334,7 +436,8 @@ typedef struct PACKED ec_alstatus
 } ec_alstatust;
 PACKED_END
 
-/** stack structure to store segmented LRD/LWR/LRW constructs */
+/** stack structure to store segmented LRD/LWR/LRW constructs, no longer
+ * used, process data frames in flight are tracked per group */
 typedef struct ec_idxstack
 {
    uint8   pushed;
@@ -383,6 +486,40 @@ typedef struct PACKED ec_PDOdesc
 } ec_PDOdesct;
 PACKED_END
 
+/** One page of the SII cache, EC_SIIPAGESIZE bytes of the SII of a slave */
+typedef struct ec_siipage
+{
+   /** slave the page belongs to, 0 if free */
+   uint16         slave;
+   /** SII byte address of the page divided by EC_SIIPAGESIZE */
+   uint16         page;
+   /** next page in the same hash bucket, index + 1, 0 at the end */
+   uint16         next;
+   /** bitmap of the bytes read into data */
+   uint32         map;
+   /** SII bytes */
+   uint8          data[EC_SIIPAGESIZE];
+} ec_siipaget;
+
+/** SII cache of all slaves, a bounded arena of pages found by slave and
+ * address through a hash table. Set up with ecx_siicache_init().
+ */
+typedef struct ec_siicache
+{
+   /** pages, supplied by the application */
+   ec_siipaget    *page;
+   /** number of pages */
+   int            maxpage;
+   /** internal, number of pages taken so far */
+   int            npage;
+   /** internal, page to reuse next when all are taken */
+   int            victim;
+   /** internal, last page found, index + 1 */
+   uint16         last;
+   /** internal, first page of each hash bucket, index + 1 */
+   uint16         hash[EC_SIIHASH];
+} ec_siicachet;
+
 /** Context structure , referenced by all ecx functions*/
 struct ecx_context
 {
@@ -398,7 +535,8 @@ struct ecx_context
    ec_groupt      *grouplist;
    /** maximum number of groups allowed in grouplist */
    int            maxgroup;
-   /** internal, reference to eeprom cache buffer */
+   /** internal, reference to eeprom cache buffer, used for one slave at a
+    * time when no siicache is set */
    uint8          *esibuf;
    /** internal, reference to eeprom cache map */
    uint32         *esimap;
@@ -406,7 +544,7 @@ struct ecx_context
    uint16         esislave;
    /** internal, reference to error list */
    ec_eringt      *elist;
-   /** internal, reference to processdata stack buffer info */
+   /** internal, reference to processdata stack buffer info, not used */
    ec_idxstackT   *idxstack;
    /** reference to ecaterror state */
    boolean        *ecaterror;
@@ -431,6 +569,14 @@ struct ecx_context
    /** userdata, promotes application configuration esp. in EC_VER2 with multiple 
     * ec_context instances. Note: userdata memory is managed by application, not SOEM */
    void           *userdata;
+   /** optional slave cache, see ecx_cache_init(), NULL if not used */
+   ec_cachet      *cache;
+   /** SII cache of all slaves, see ecx_siicache_init(), NULL to use esibuf */
+   ec_siicachet   *siicache;
+   /** flag to copy the CoE or SoE mapping of a slave from the first identical
+    * slave instead of reading it through the mailbox, off by default as
+    * slaves with the same identity may be configured differently */
+   int            reusemapping;
 };
 
 #ifdef EC_VER1
@@ -476,9 +622,12 @@ uint64 ec_readeepromFP(uint16 configadr, uint16 eeproma, int timeout);
 int ec_writeeepromFP(uint16 configadr, uint16 eeproma, uint16 data, int timeout);
 void ec_readeeprom1(uint16 slave, uint16 eeproma);
 uint32 ec_readeeprom2(uint16 slave, int timeout);
+int ec_readeeprom_multi(const uint16 *slaves, int n, uint16 eeproma, uint32 *edat, int timeout);
 int ec_send_processdata_group(uint8 group);
 int ec_send_overlap_processdata_group(uint8 group);
 int ec_receive_processdata_group(uint8 group, int timeout);
+int ec_receive_processdata_group_deadline(uint8 group, int64 deadline);
+boolean ec_inputs_changed(uint16 slave);
 int ec_send_processdata(void);
 int ec_send_overlap_processdata(void);
 int ec_receive_processdata(int timeout);
@@ -495,6 +644,8 @@ void ecx_packeterror(ecx_contextt *context, uint16 Slave, uint16 Index, uint8 Su
 int ecx_init(ecx_contextt *context, const char * ifname);
 int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char *ifname, char *if2name);
 void ecx_close(ecx_contextt *context);
+void ecx_siicache_init(ecx_contextt *context, ec_siicachet *siicache, ec_siipaget *page, int maxpage);
+void ecx_siicache_clear(ecx_contextt *context);
 uint8 ecx_siigetbyte(ecx_contextt *context, uint16 slave, uint16 address);
 int16 ecx_siifind(ecx_contextt *context, uint16 slave, uint16 cat);
 void ecx_siistring(ecx_contextt *context, char *str, uint16 slave, uint16 Sn);
@@ -516,15 +667,24 @@ int ecx_eeprom2pdi(ecx_contextt *context, uint16 slave);
 uint64 ecx_readeepromAP(ecx_contextt *context, uint16 aiadr, uint16 eeproma, int timeout);
 int ecx_writeeepromAP(ecx_contextt *context, uint16 aiadr, uint16 eeproma, uint16 data, int timeout);
 uint64 ecx_readeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma, int timeout);
+boolean ecx_readeepromFP_data(ecx_contextt *context, uint16 configadr, uint16 eeproma,
+                               int timeout, uint64 *data);
 int ecx_writeeepromFP(ecx_contextt *context, uint16 configadr, uint16 eeproma, uint16 data, int timeout);
 void ecx_readeeprom1(ecx_contextt *context, uint16 slave, uint16 eeproma);
 uint32 ecx_readeeprom2(ecx_contextt *context, uint16 slave, int timeout);
+int ecx_readeeprom_multi(ecx_contextt *context, const uint16 *slaves, int n,
+                         uint16 eeproma, uint32 *edat, int timeout);
 int ecx_send_overlap_processdata_group(ecx_contextt *context, uint8 group);
 int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout);
+int ecx_receive_processdata_group_deadline(ecx_contextt *context, uint8 group, int64 deadline);
+boolean ecx_inputs_changed(ecx_contextt *context, uint16 slave);
 int ecx_send_processdata(ecx_contextt *context);
 int ecx_send_overlap_processdata(ecx_contextt *context);
 int ecx_receive_processdata(ecx_contextt *context, int timeout);
+int ecx_compile_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io);
 int ecx_send_processdata_group(ecx_contextt *context, uint8 group);
+int ecx_send_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups);
+int ecx_send_overlap_processdata_groups(ecx_contextt *context, const uint8 *groups, int ngroups);
 
 #ifdef __cplusplus
 }
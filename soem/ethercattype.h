@@ -60,6 +60,12 @@ extern "C"
 #define EC_ECATTYPE        0x1000
 /** number of frame buffers per channel (tx, rx1 rx2) */
 #define EC_MAXBUF          16
+/** maximum number of frame buffers per channel for ports with a runtime
+ * sized buffer pool, limited by the 8 bit frame index */
+#define EC_MAXBUFPOOL      256
+/** frame index returned by ecx_getindex() when all indexes are in use, never
+ * a valid index */
+#define EC_NOINDEX         (EC_MAXBUFPOOL - 1)
 /** timeout value in us for tx frame to return to rx */
 #define EC_TIMEOUTRET      2000
 /** timeout value in us for safe data transfer, max. triple retry */
@@ -77,7 +83,7 @@ extern "C"
 /** size of EEPROM bitmap cache */
 #define EC_MAXEEPBITMAP    128
 /** size of EEPROM cache buffer */
-#define EC_MAXEEPBUF       EC_MAXEEPBITMAP << 5
+#define EC_MAXEEPBUF       (EC_MAXEEPBITMAP << 5)
 /** default number of retries if wkc <= 0 */
 #define EC_DEFAULTRETRIES  3
 /** default group size in 2^x */
@@ -0,0 +1,118 @@
+/** \file
+ * \brief Stress test of the triple buffered process image
+ *
+ * Usage : pdimage_test [seconds] [size]
+ * Default is 5 seconds with a 1024 byte image.
+ *
+ * A producer thread fills the whole write buffer with its commit count and
+ * commits it as fast as it can, the main thread reads the newest image as
+ * fast as it can. Every image read must hold one count in all words, and
+ * the count must never go back. No NIC or slaves are needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ethercat.h"
+
+#define MAXSIZE 65536
+
+static uint8 imagebuf[3 * MAXSIZE];
+static ec_pdimaget image;
+static volatile int run;
+static volatile int running;
+static volatile uint32 commits;
+
+OSAL_THREAD_FUNC producer( void *ptr )
+{
+   uint32 *words;
+   uint32 seq, i, n;
+   (void)ptr;                  /* Not used */
+
+   n = image.size / sizeof(uint32);
+   seq = 0;
+   while (run)
+   {
+      seq++;
+      words = (uint32 *)ecx_pdimage_write(&image);
+      for (i = 0; i < n; i++)
+      {
+         words[i] = seq;
+      }
+      ecx_pdimage_commit(&image);
+      commits = seq;
+   }
+   running = FALSE;
+}
+
+int main(int argc, char *argv[])
+{
+   OSAL_THREAD_HANDLE thread1;
+   const uint32 *words;
+   uint32 last, seq, i, n, size;
+   uint64 reads, changes, torn, back;
+   int64 stop;
+   int seconds;
+
+   printf("SOEM (Simple Open EtherCAT Master)\nProcess image stress test\n");
+
+   seconds = (argc > 1) ? atoi(argv[1]) : 5;
+   size = (argc > 2) ? (uint32)atoi(argv[2]) : 1024;
+   if ((seconds <= 0) || (size < sizeof(uint32)) || (size > MAXSIZE))
+   {
+      printf("Usage: pdimage_test [seconds] [size]\nsize = 4 .. %d bytes\n", MAXSIZE);
+      return 2;
+   }
+   ecx_pdimage_init(&image, imagebuf, size);
+   n = size / sizeof(uint32);
+   run = TRUE;
+   running = TRUE;
+   if (!osal_thread_create(&thread1, 128000, &producer, NULL))
+   {
+      printf("Could not create producer thread\n");
+      return 2;
+   }
+
+   last = 0;
+   reads = changes = torn = back = 0;
+   stop = osal_monotonic_ns() + ((int64)seconds * 1000000000);
+   while (osal_monotonic_ns() < stop)
+   {
+      words = (const uint32 *)ecx_pdimage_read(&image);
+      seq = words[0];
+      for (i = 1; i < n; i++)
+      {
+         if (words[i] != seq)
+         {
+            torn++;
+            break;
+         }
+      }
+      if (seq < last)
+      {
+         back++;
+      }
+      else if (seq > last)
+      {
+         changes++;
+      }
+      last = seq;
+      reads++;
+   }
+   run = FALSE;
+   while (running)
+   {
+      osal_usleep(1000);
+   }
+
+   printf("commits %u reads %llu new images %llu torn %llu out of order %llu\n",
+          (unsigned)commits, (unsigned long long)reads, (unsigned long long)changes,
+          (unsigned long long)torn, (unsigned long long)back);
+   if (torn || back || !changes)
+   {
+      printf("FAILED\n");
+      return 1;
+   }
+   printf("OK\n");
+   return 0;
+}